@@ -12,13 +12,21 @@ declare const enum BranchType {
 declare interface monostate {}
 type LeafCallback<C,M> = (ctx: C, memory: M) => Result | number
 type DecoratorCallback<C,M> = (ctx: C, memory: M) => Result | number
+// Called once for a whole batch of executors, returns one result per executor
+type BatchLeafCallback<C,M> = (ctxs: C[], memories: M[]) => (Result | number)[]
 type Builder<T> = (arg: T) => void
+// Arguments of callbacks registered as factories in the native CallbackRegistry
+type CallbackArgs = number[]
 
 declare interface RootNode<C,LC,DC> {}
 
 declare interface DecorableNode<C,LC,DC,T> extends RootNode<C,LC,DC> {
     Decorate(callback: DecoratorCallback<C,DC>): T
     Decorate(callbacks: DecoratorCallback<C,DC>[]): T
+    Decorate(name: string, args?: CallbackArgs): T
+    // Also re-evaluated whenever the executor is notified of "event"
+    DecorateOn(event: string, callback: DecoratorCallback<C,DC>): T
+    DecorateOn(event: string, name: string, args?: CallbackArgs): T
 }
 
 declare interface Leaf<C,LC,DC> extends DecorableNode<C,LC,DC,Leaf<C,LC,DC>> {}
@@ -28,10 +36,17 @@ declare interface BranchNode<C,LC,DC,T> extends DecorableNode<C,LC,DC,T> {
     AddSelector(builder: Builder<Branch<C,LC,DC>>): T
 
     AddLeaf(callback: LeafCallback<C,LC>, builder?: Builder<Leaf<C,LC,DC>>);
+    AddLeaf(name: string, builder?: Builder<Leaf<C,LC,DC>>);
+    AddLeaf(name: string, args: CallbackArgs, builder?: Builder<Leaf<C,LC,DC>>);
     AddNode(node: RootNode<C,LC,DC>);
+    // Cannot be serialized and never keeps its state across ReplaceTree,
+    // unlike a batch leaf registered by name and added with AddLeaf
+    AddBatchLeaf(callback: BatchLeafCallback<C,LC>, builder?: Builder<Leaf<C,LC,DC>>);
 
     AddMultiplexer(callback: LeafCallback<C,LC>, builder: Builder<Multiplexer<C,LC,DC>>);
     AddMultiplexer(builder: Builder<Multiplexer<C,LC,DC>>);
+    AddMultiplexer(name: string, builder: Builder<Multiplexer<C,LC,DC>>);
+    AddMultiplexer(name: string, args: CallbackArgs, builder: Builder<Multiplexer<C,LC,DC>>);
 }
 
 declare interface Multiplexer<C,LC,DC> extends BranchNode<C,LC,DC,Multiplexer<C,LC,DC>> {}
@@ -0,0 +1,252 @@
+// Update throughput benchmark over synthetic trees.
+//
+//   BehaviorTreeBench [--depth N] [--fanout N] [--selectors RATIO]
+//                     [--decorators DENSITY] [--multiplexers N]
+//                     [--delay-chance P] [--max-delay N] [--ticks N]
+//                     [--interval N] [--agents N[,N...]] [--seed N]
+//
+// Builds one random tree from the parameters and, for every population
+// size, updates that many executors of it for the given number of ticks.
+// A tick interval above 1 measures executors at a lower level of detail.
+#include "BehaviorTree.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+
+static std::atomic<size_t> allocations = 0;
+
+// GCC matches the std::free of an inlined replacement delete against the
+// operator new it was allocated with, and the malloc of an inlined
+// replacement new against the operator delete it is freed with, and warns
+// about the mismatch
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(std::size_t size)
+{
+    allocations++;
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using MS = std::monostate;
+
+struct BenchAgent
+{
+    uint64_t m_rng;
+
+    // xorshift64, cheap enough not to dominate leaf cost
+    uint32_t Next()
+    {
+        m_rng ^= m_rng << 13;
+        m_rng ^= m_rng >> 7;
+        m_rng ^= m_rng << 17;
+        return uint32_t(m_rng >> 32);
+    }
+
+    bool Chance(double probability)
+    {
+        return Next() < probability * 4294967296.0;
+    }
+};
+
+struct BenchConfig
+{
+    uint32_t m_depth = 4;
+    uint32_t m_fanOut = 4;
+    double m_selectorRatio = 0.5;
+    double m_decoratorDensity = 0.2;
+    uint32_t m_multiplexers = 0;
+    double m_delayChance = 0.3;
+    uint32_t m_maxDelay = 10;
+    uint32_t m_ticks = 100;
+    uint32_t m_tickInterval = 0;
+    std::vector<size_t> m_agents = { 1000, 10000, 100000 };
+    uint64_t m_seed = 1;
+};
+
+struct BenchTree
+{
+    uint32_t m_nodes = 0;
+    uint32_t m_decorators = 0;
+    uint32_t m_multiplexers = 0;
+};
+
+using BenchNode = Node<BenchAgent,MS,MS>;
+
+static int RandomResult(BenchAgent& agent, double delayChance, uint32_t maxDelay, double failureChance)
+{
+    if (agent.Chance(delayChance))
+    {
+        return 1 + int(agent.Next() % maxDelay);
+    }
+    return agent.Chance(failureChance) ? Result::FAILURE : Result::SUCCESS;
+}
+
+template <typename T>
+static void Decorate(DecorableNode<BenchAgent,MS,MS,T>* node, BenchConfig const& config, std::mt19937_64& rng, BenchTree& stats)
+{
+    std::uniform_real_distribution<double> chance;
+    while (chance(rng) < config.m_decoratorDensity)
+    {
+        double delayChance = config.m_delayChance;
+        uint32_t maxDelay = config.m_maxDelay;
+        node->Decorate([=](BenchAgent& agent, MS&) { return RandomResult(agent, delayChance, maxDelay, 0.05); });
+        stats.m_decorators++;
+    }
+}
+
+static BenchNode* Generate(BehaviorTreeContext<BenchAgent>& ctx, BenchConfig const& config, std::mt19937_64& rng, uint32_t depth, BenchTree& stats)
+{
+    std::uniform_real_distribution<double> chance;
+    stats.m_nodes++;
+    if (depth >= config.m_depth)
+    {
+        double delayChance = config.m_delayChance;
+        uint32_t maxDelay = config.m_maxDelay;
+        Leaf<BenchAgent>* leaf = ctx.CreateLeaf([=](BenchAgent& agent, MS&) { return RandomResult(agent, delayChance, maxDelay, 0.2); });
+        Decorate(leaf, config, rng, stats);
+        return leaf;
+    }
+
+    if (depth > 0 && stats.m_multiplexers < config.m_multiplexers)
+    {
+        stats.m_multiplexers++;
+        Multiplexer<BenchAgent>* multiplexer = ctx.CreateMultiplexer([](BenchAgent& agent, MS&) { return agent.Chance(0.05) ? Result::SUCCESS : 1; });
+        for (uint32_t i = 0; i < config.m_fanOut; ++i)
+        {
+            multiplexer->AddNode(Generate(ctx, config, rng, depth + 1, stats));
+        }
+        Decorate(multiplexer, config, rng, stats);
+        return multiplexer;
+    }
+
+    Branch<BenchAgent>* branch = chance(rng) < config.m_selectorRatio ? ctx.CreateSelector() : ctx.CreateSequence();
+    for (uint32_t i = 0; i < config.m_fanOut; ++i)
+    {
+        branch->AddNode(Generate(ctx, config, rng, depth + 1, stats));
+    }
+    Decorate(branch, config, rng, stats);
+    return branch;
+}
+
+static bool ParseArgs(int argc, char** argv, BenchConfig& config)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        char const* value = argv[i + 1];
+        if (flag == "--depth") config.m_depth = uint32_t(std::strtoul(value, nullptr, 10));
+        else if (flag == "--fanout") config.m_fanOut = uint32_t(std::strtoul(value, nullptr, 10));
+        else if (flag == "--selectors") config.m_selectorRatio = std::strtod(value, nullptr);
+        else if (flag == "--decorators") config.m_decoratorDensity = std::strtod(value, nullptr);
+        else if (flag == "--multiplexers") config.m_multiplexers = uint32_t(std::strtoul(value, nullptr, 10));
+        else if (flag == "--delay-chance") config.m_delayChance = std::strtod(value, nullptr);
+        else if (flag == "--max-delay") config.m_maxDelay = std::max<uint32_t>(1, uint32_t(std::strtoul(value, nullptr, 10)));
+        else if (flag == "--ticks") config.m_ticks = uint32_t(std::strtoul(value, nullptr, 10));
+        else if (flag == "--interval") config.m_tickInterval = uint32_t(std::strtoul(value, nullptr, 10));
+        else if (flag == "--seed") config.m_seed = std::strtoull(value, nullptr, 10);
+        else if (flag == "--agents")
+        {
+            config.m_agents.clear();
+            std::stringstream list(value);
+            std::string count;
+            while (std::getline(list, count, ','))
+            {
+                config.m_agents.push_back(std::strtoull(count.c_str(), nullptr, 10));
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+    // decorator density is a geometric parameter, 1 would never terminate
+    config.m_decoratorDensity = std::min(config.m_decoratorDensity, 0.9);
+    return (argc - 1) % 2 == 0;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConfig config;
+    if (!ParseArgs(argc, argv, config))
+    {
+        std::fprintf(stderr, "usage: %s [--depth N] [--fanout N] [--selectors RATIO] [--decorators DENSITY] [--multiplexers N] [--delay-chance P] [--max-delay N] [--ticks N] [--interval N] [--agents N[,N...]] [--seed N]\n", argv[0]);
+        return 1;
+    }
+
+    BehaviorTreeContext<BenchAgent> ctx;
+    std::mt19937_64 rng(config.m_seed);
+    BenchTree stats;
+    BenchNode* root = Generate(ctx, config, rng, 0, stats);
+    ctx.Freeze();
+    auto tree = ctx.Compile(root);
+
+    std::printf("tree: %u nodes, %u decorators, %u multiplexers (depth %u, fan-out %u)\n",
+        stats.m_nodes, stats.m_decorators, stats.m_multiplexers, config.m_depth, config.m_fanOut);
+    std::printf("%10s %14s %16s %16s\n", "agents", "ns/update", "allocs/update", "agents/sec");
+
+    for (size_t agentCount : config.m_agents)
+    {
+        std::vector<TreeExecutor<BenchAgent>> executors(agentCount, TreeExecutor<BenchAgent>(tree));
+        std::vector<BenchAgent> agents(agentCount);
+        for (size_t i = 0; i < agentCount; ++i)
+        {
+            agents[i].m_rng = (config.m_seed + i) * 0x9E3779B97F4A7C15ull | 1;
+            executors[i].SetTickInterval(config.m_tickInterval);
+        }
+
+        // first updates grow stacks and subtrees, keep them out of the numbers
+        uint64_t now = 0;
+        for (uint32_t tick = 0; tick < 10; ++tick, ++now)
+        {
+            for (size_t i = 0; i < agentCount; ++i)
+            {
+                executors[i].Update(agents[i], now);
+            }
+        }
+
+        size_t allocationsBefore = allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t tick = 0; tick < config.m_ticks; ++tick, ++now)
+        {
+            for (size_t i = 0; i < agentCount; ++i)
+            {
+                executors[i].Update(agents[i], now);
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        size_t allocationCount = allocations - allocationsBefore;
+
+        double updates = double(agentCount) * config.m_ticks;
+        std::printf("%10zu %14.1f %16.4f %16.0f\n",
+            agentCount,
+            elapsed * 1e9 / updates,
+            double(allocationCount) / updates,
+            updates / elapsed);
+    }
+    return 0;
+}
@@ -4,6 +4,19 @@
 #include <vector>
 #include <cstdint>
 #include <variant>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <type_traits>
+#ifdef BT_COROUTINES
+#include "BehaviorTreeCoroutine.h"
+#endif
 
 //
 // Declarations
@@ -29,15 +42,82 @@ class Multiplexer;
 template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
 class BehaviorTreeContext;
 
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class CompiledTree;
+
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class CallbackRegistry;
+
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class TreeSerializer;
+
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class TraceReplay;
+
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class LeafBatch;
+
 template <typename C = std::monostate, typename M = std::monostate>
 using DecoratorCallback = std::function<int(C&,M&)>;
 
 template <typename C = std::monostate, typename M = std::monostate>
 using LeafCallback = std::function<int(C&,M&)>;
 
+// Runs a batched leaf (see BranchNode::AddBatchLeaf) for "count" executors
+// at once. contexts[i] and memories[i] belong to the i-th executor, whose
+// result goes into results[i].
+template <typename C = std::monostate, typename M = std::monostate>
+using BatchLeafCallback = std::function<void(size_t count, std::remove_reference_t<C>* const* contexts, M* const* memories, int* results)>;
+
+#ifdef BT_COROUTINES
+// Starts the coroutine of a coroutine leaf. The context is the one passed to
+// the update that entered the leaf, and is used until the coroutine ends.
+template <typename C = std::monostate>
+using CoroutineLeafCallback = std::function<TreeTask(C&)>;
+#endif
+
+// Type-erased memory of a typed leaf or decorator, see TypedCallback
+struct TreeMemoryType
+{
+    size_t m_size;
+    size_t m_align;
+    void (*m_construct)(void* memory);
+    void (*m_destroy)(void* memory);
+    // move constructs "to" from "from", then destroys "from"
+    void (*m_relocate)(void* to, void* from);
+    // nullptr if the type cannot be copied
+    void (*m_copy)(void* to, void const* from);
+
+    template <typename M>
+    static TreeMemoryType const* Of();
+};
+
+// Leaf or decorator callback declaring a memory type of its own instead of
+// using LC or DC. Its memory lives in the executors TreeSlab, and only
+// while the node is on the stacks.
+template <typename C = std::monostate>
+struct TypedCallback
+{
+    std::function<int(C&,void*)> m_callback;
+    // nullptr for callbacks using LC or DC
+    TreeMemoryType const* m_memory = nullptr;
+
+    template <typename M>
+    static TypedCallback Of(std::function<int(C&,M&)> callback);
+};
+
 template <typename T>
 using Builder = std::function<void(T*)>;
 
+using TreeArenaId = uint32_t;
+
+// Numeric arguments of a parameterized registered callback
+using CallbackArgs = std::vector<double>;
+
+// Event registered in a CallbackRegistry, see DecorableNode::DecorateOn
+using TreeEventId = uint32_t;
+inline constexpr TreeEventId NO_TREE_EVENT = UINT32_MAX;
+
 enum class BranchType: int
 {
     SEQUENCE,
@@ -58,8 +138,85 @@ enum class TraversalMode: int
     TRAVERSAL
 };
 
+enum class NodeKind: uint32_t
+{
+    LEAF,
+    SEQUENCE,
+    SELECTOR,
+    MULTIPLEXER,
+    COROUTINE_LEAF
+};
+
 TraversalMode ResultToTraversal(Result result);
 
+//
+// Callback Registry
+//
+
+// Name and arguments of a callback registered in a CallbackRegistry, the
+// name is empty for callbacks passed to the builders directly.
+struct CallbackSymbol
+{
+    std::string m_name;
+    CallbackArgs m_args;
+    // decorators only, event the decorator is re-evaluated on if not empty
+    std::string m_event;
+    // set when compiled, see CallbackRegistry::MarkLeafPerTick
+    bool m_perTick = false;
+    bool IsNamed() const;
+};
+
+// Callbacks that trees can refer to by name, which is what allows them to
+// be serialized and lets trees built from scripts run native callbacks.
+//
+// Factories are parameterized callbacks: they are called once per node with
+// the arguments the node was built with (e.g. "HealthBelow", {0.3}) and the
+// callback they return is what the executors run.
+template <typename C, typename LC, typename DC>
+class CallbackRegistry
+{
+public:
+    using LeafFactory = std::function<LeafCallback<C,LC>(CallbackArgs const&)>;
+    using DecoratorFactory = std::function<DecoratorCallback<C,DC>(CallbackArgs const&)>;
+
+    // Leaf callbacks are used for both leaves and multiplexers
+    void RegisterLeaf(std::string const& name, LeafCallback<C,LC> callback);
+    // Leaves added by this name are batch leaves (see
+    // BranchNode::AddBatchLeaf), which also run as a batch of one where
+    // they are used as a plain leaf callback
+    void RegisterBatchLeaf(std::string const& name, BatchLeafCallback<C,LC> callback);
+    void RegisterDecorator(std::string const& name, DecoratorCallback<C,DC> callback);
+    void RegisterLeafFactory(std::string const& name, LeafFactory factory);
+    void RegisterDecoratorFactory(std::string const& name, DecoratorFactory factory);
+    // Throw if no callback is registered under that name, or if arguments
+    // are passed to a callback that is not a factory
+    LeafCallback<C,LC> GetLeaf(std::string const& name, CallbackArgs const& args = {}) const;
+    DecoratorCallback<C,DC> GetDecorator(std::string const& name, CallbackArgs const& args = {}) const;
+    bool HasLeaf(std::string const& name) const;
+    // nullptr if "name" is not registered as a batch leaf
+    std::shared_ptr<BatchLeafCallback<C,LC> const> GetBatchLeaf(std::string const& name) const;
+    bool HasDecorator(std::string const& name) const;
+    // Events get ids in registration order, registering one again returns
+    // its existing id. GetEvent throws if the event is not registered.
+    TreeEventId RegisterEvent(std::string const& name);
+    TreeEventId GetEvent(std::string const& name) const;
+    // Marks callbacks whose result only depends on the context and the
+    // update, not on their memory (e.g. "HasTarget"). Executors call them
+    // at most once per update for each set of arguments, and every node
+    // using them shares the result. Applies to trees compiled afterwards.
+    void MarkLeafPerTick(std::string const& name);
+    void MarkDecoratorPerTick(std::string const& name);
+    bool IsLeafPerTick(std::string const& name) const;
+    bool IsDecoratorPerTick(std::string const& name) const;
+private:
+    std::unordered_map<std::string, LeafFactory> m_leaves;
+    std::unordered_map<std::string, DecoratorFactory> m_decorators;
+    std::unordered_map<std::string, std::shared_ptr<BatchLeafCallback<C,LC> const>> m_batchLeaves;
+    std::unordered_map<std::string, TreeEventId> m_events;
+    std::unordered_set<std::string> m_perTickLeaves;
+    std::unordered_set<std::string> m_perTickDecorators;
+};
+
 //
 // Builder Classes
 //
@@ -69,12 +226,19 @@ class Node
 {
 public:
     virtual ~Node();
-    Node(BehaviorTreeContext<C,LC,DC>* gen);
+    Node(BehaviorTreeContext<C,LC,DC>* gen, NodeKind kind);
 protected:
+    void OnModify();
     BehaviorTreeContext<C,LC,DC>* m_gen;
-    std::vector<DecoratorCallback<C,DC>> m_decorations;
+    NodeKind m_kind;
+    std::pmr::vector<DecoratorCallback<C,DC>> m_decorations;
+    // parallel to m_decorations
+    std::pmr::vector<CallbackSymbol> m_decorationSymbols;
+    // by index into m_decorations, shorter if the last ones are not typed
+    std::pmr::vector<TypedCallback<C>> m_typedDecorations;
     friend class TreeExecutor<C,LC,DC>;
     friend class BehaviorTreeContext<C,LC,DC>;
+    friend class CompiledTree<C,LC,DC>;
 };
 
 template <typename C, typename LC, typename DC, typename T>
@@ -83,8 +247,20 @@ class DecorableNode : public Node<C,LC,DC>
 public:
     T* Decorate(DecoratorCallback<C,DC> predicate);
     T* Decorate(std::vector<DecoratorCallback<C,DC>> predicates);
+    // Decorates with a callback registered in the contexts CallbackRegistry
+    T* Decorate(std::string const& name, CallbackArgs const& args = {});
+    // Decorators that are re-evaluated whenever "event" is passed to
+    // TreeExecutor::Notify, on top of their delays. Unlike other decorators
+    // they stay active after returning SUCCESS, so one that never returns a
+    // delay is only evaluated when the node is entered and on its event.
+    // Registers "event" in the contexts CallbackRegistry.
+    T* DecorateOn(std::string const& event, DecoratorCallback<C,DC> predicate);
+    T* DecorateOn(std::string const& event, std::string const& name, CallbackArgs const& args = {});
+    // Decorators with memory of type M instead of DC, see TypedCallback
+    template <typename M>
+    T* DecorateTyped(std::function<int(C&,M&)> predicate);
 protected:
-    DecorableNode(BehaviorTreeContext<C,LC,DC>* gen);
+    DecorableNode(BehaviorTreeContext<C,LC,DC>* gen, NodeKind kind);
 };
 
 template <typename C, typename LC, typename DC>
@@ -92,10 +268,20 @@ class Leaf : public DecorableNode<C,LC,DC, Leaf<C,LC,DC>>
 {
 public:
     Leaf(BehaviorTreeContext<C,LC,DC>* gen, LeafCallback<C,LC> exec);
+    Leaf(BehaviorTreeContext<C,LC,DC>* gen, TypedCallback<C> typed);
+#ifdef BT_COROUTINES
+    Leaf(BehaviorTreeContext<C,LC,DC>* gen, CoroutineLeafCallback<C> coroutine);
+#endif
 private:
     LeafCallback<C,LC> m_exec;
+    TypedCallback<C> m_typed;
+#ifdef BT_COROUTINES
+    CoroutineLeafCallback<C> m_coroutine;
+#endif
+    CallbackSymbol m_symbol;
     friend class BehaviorTreeContext<C,LC,DC>;
     friend class TreeExecutor<C,LC,DC>;
+    friend class CompiledTree<C,LC,DC>;
     friend struct LeafEndpoint<C,LC,DC>;
 };
 
@@ -110,10 +296,43 @@ public:
     T* AddNode(Node<C,LC,DC>* node);
     T* AddMultiplexer(LeafCallback<C,LC> callback, Builder<Multiplexer<C,LC,DC>> builder);
     T* AddMultiplexer(Builder<Multiplexer<C,LC,DC>> builder);
-    BranchNode(BehaviorTreeContext<C,LC,DC>* ctx);
+    // Variants taking callbacks registered in the contexts CallbackRegistry
+    T* AddLeaf(std::string const& name, Builder<Leaf<C,LC,DC>> builder);
+    T* AddLeaf(std::string const& name, CallbackArgs const& args, Builder<Leaf<C,LC,DC>> builder);
+    T* AddLeaf(std::string const& name, CallbackArgs const& args = {});
+    T* AddMultiplexer(std::string const& name, Builder<Multiplexer<C,LC,DC>> builder);
+    T* AddMultiplexer(std::string const& name, CallbackArgs const& args, Builder<Multiplexer<C,LC,DC>> builder);
+    // Leaves with memory of type M instead of LC, see TypedCallback. With
+    // typed leaves and decorators, LC and DC can be left std::monostate and
+    // an executor only holds the memory of the nodes it is running.
+    template <typename M>
+    T* AddTypedLeaf(std::function<int(C&,M&)> exec, Builder<Leaf<C,LC,DC>> builder);
+    template <typename M>
+    T* AddTypedLeaf(std::function<int(C&,M&)> exec);
+    // Leaves whose callback runs for many executors at once. Executors
+    // updated with a LeafBatch queue the leaf into it instead of calling it,
+    // and continue with its result on their next update after the batch has
+    // run (see TreeScheduler::SetLeafBatching). Other updates call it for a
+    // batch of one. Like other leaves built from a callback, these cannot be
+    // serialized or interned and never keep their state across ReplaceTree;
+    // batch leaves registered with CallbackRegistry::RegisterBatchLeaf and
+    // added with AddLeaf(name) can.
+    T* AddBatchLeaf(BatchLeafCallback<C,LC> exec, Builder<Leaf<C,LC,DC>> builder);
+    T* AddBatchLeaf(BatchLeafCallback<C,LC> exec);
+#ifdef BT_COROUTINES
+    // Leaves running a coroutine instead of a callback, which keeps its
+    // state in its frame rather than in the leaf memory. The coroutine
+    // starts when the leaf is entered and its frame is destroyed when the
+    // leaf ends or is interrupted, e.g. by a failing decorator.
+    T* AddCoroutineLeaf(CoroutineLeafCallback<C> coroutine, Builder<Leaf<C,LC,DC>> builder);
+    T* AddCoroutineLeaf(CoroutineLeafCallback<C> coroutine);
+#endif
+    BranchNode(BehaviorTreeContext<C,LC,DC>* ctx, NodeKind kind);
 protected:
-    std::vector<Node<C,LC,DC>*> m_children;
+    std::pmr::vector<Node<C,LC,DC>*> m_children;
     friend class TreeExecutor<C,LC,DC>;
+    friend class CompiledTree<C,LC,DC>;
+    friend class BehaviorTreeContext<C,LC,DC>;
 };
 
 template <typename C, typename LC, typename DC>
@@ -123,8 +342,10 @@ public:
     Multiplexer(BehaviorTreeContext<C,LC,DC>* gen, LeafCallback<C,LC> exec = nullptr);
 protected:
     LeafCallback<C,LC> m_callback;
+    CallbackSymbol m_symbol;
     friend class TreeExecutor<C,LC,DC>;
     friend class BehaviorTreeContext<C,LC,DC>;
+    friend class CompiledTree<C,LC,DC>;
     friend struct MultiplexerEndpoint<C,LC,DC>;
 };
 
@@ -141,6 +362,209 @@ protected:
     uint64_t m_attempts = 1;
     friend class TreeExecutor<C,LC,DC>;
     friend class BehaviorTreeContext<C,LC,DC>;
+    friend class CompiledTree<C,LC,DC>;
+};
+
+//
+// Compilation
+//
+
+// A single node of a CompiledTree. Children and decorators are stored as
+// index ranges into the owning tree's tables.
+struct CompiledNode
+{
+    static constexpr uint32_t NO_CALLBACK = UINT32_MAX;
+    uint64_t m_loops = 1;
+    uint64_t m_attempts = 1;
+    uint32_t m_childBegin = 0;
+    uint32_t m_childEnd = 0;
+    uint32_t m_decoratorBegin = 0;
+    uint32_t m_decoratorEnd = 0;
+    uint32_t m_callback = NO_CALLBACK;
+    NodeKind m_kind = NodeKind::LEAF;
+};
+
+//
+// Profiling
+//
+
+// Counters of a single compiled node, summed over every executor running
+// its tree. Decorator counters are attributed to the decorated node.
+struct NodeProfile
+{
+    uint32_t m_tree = 0; // index into ProfileSnapshot::m_trees
+    uint32_t m_node = 0; // index into the compiled tree
+    NodeKind m_kind = NodeKind::LEAF;
+    std::string m_name;  // registered callback name, if any
+    uint64_t m_visits = 0;
+    uint64_t m_calls = 0;
+    uint64_t m_successes = 0;
+    uint64_t m_failures = 0;
+    uint64_t m_delays = 0;
+    uint64_t m_callNanos = 0;
+    uint64_t m_maxCallNanos = 0;
+    uint64_t m_decoratorCalls = 0;
+    uint64_t m_decoratorFailures = 0;
+    uint64_t m_decoratorNanos = 0;
+    uint64_t m_maxDecoratorNanos = 0;
+};
+
+struct TreeProfile
+{
+    void const* m_root = nullptr; // root node, if compiled from a context
+    uint64_t m_updates = 0;
+    uint64_t m_rebuilds = 0;
+    uint64_t m_traversals = 0;
+};
+
+struct ProfileSnapshot
+{
+    std::vector<TreeProfile> m_trees;
+    std::vector<NodeProfile> m_nodes;
+};
+
+// Flattened, immutable copy of a node graph rooted at a single node.
+// Nodes are laid out in pre-order (the root is always index 0), shared
+// nodes and cycles created with AddNode are only emitted once.
+template <typename C, typename LC, typename DC>
+class CompiledTree
+{
+public:
+    static constexpr uint32_t UNBOUNDED = UINT32_MAX;
+    CompiledTree(Node<C,LC,DC>* root);
+    size_t NodeCount() const;
+    // Largest node/decorator stack an executor of this tree can reach,
+    // UNBOUNDED if the tree is recursive. Multiplexer subtrees run in
+    // executors of their own and are not included.
+    uint32_t MaxNodeDepth() const;
+    uint32_t MaxDecoratorDepth() const;
+#ifdef BT_PROFILING
+    // Appends this trees counters to "snapshot"
+    void Profile(ProfileSnapshot& snapshot, void const* root = nullptr) const;
+    void ResetProfile() const;
+#endif
+private:
+    CompiledTree() = default;
+    uint32_t Compile(Node<C,LC,DC>* node, std::unordered_map<Node<C,LC,DC>*, uint32_t>& indices);
+    // points the node/child tables at their storage and computes depths
+    void Finalize(CompiledNode const* nodes, size_t nodeCount, uint32_t const* children);
+    void ComputeDepth(uint32_t root, std::vector<uint8_t>& state, std::vector<uint32_t>& nodeDepth, std::vector<uint32_t>& decoratorDepth);
+    void AssignMemos();
+    uint32_t m_maxNodeDepth = 0;
+    uint32_t m_maxDecoratorDepth = 0;
+    // node and child tables either point into the storage vectors or into
+    // memory kept alive by m_mapping (see TreeSerializer)
+    CompiledNode const* m_nodes = nullptr;
+    uint32_t const* m_children = nullptr;
+    size_t m_nodeCount = 0;
+    std::vector<CompiledNode> m_nodeStorage;
+    std::vector<uint32_t> m_childStorage;
+    std::shared_ptr<void const> m_mapping;
+    std::vector<LeafCallback<C,LC>> m_callbacks;
+    std::vector<DecoratorCallback<C,DC>> m_decorators;
+    // parallel to m_callbacks and m_decorators
+    std::vector<CallbackSymbol> m_callbackSymbols;
+    std::vector<CallbackSymbol> m_decoratorSymbols;
+    std::vector<TreeEventId> m_decoratorEvents;
+    // parallel to m_callbacks and m_decorators, whose entries are empty for
+    // typed callbacks
+    std::vector<TypedCallback<C>> m_typedCallbacks;
+    std::vector<TypedCallback<C>> m_typedDecorators;
+    // parallel to m_callbacks, set for batched leaves, whose m_callbacks
+    // entry runs a batch of one
+    std::vector<std::shared_ptr<BatchLeafCallback<C,LC> const>> m_batchCallbacks;
+    // slot of a TreeMemo per callback, NO_MEMO unless it is per-tick.
+    // Callbacks with the same symbol share their slot.
+    std::vector<uint32_t> m_callbackMemos;
+    std::vector<uint32_t> m_decoratorMemos;
+    uint32_t m_memoCount = 0;
+#ifdef BT_COROUTINES
+    // parallel to m_callbacks, whose entries are empty for coroutine leaves
+    std::vector<CoroutineLeafCallback<C>> m_coroutines;
+#endif
+#ifdef BT_PROFILING
+    struct NodeCounters
+    {
+        std::atomic<uint64_t> m_visits{0};
+        std::atomic<uint64_t> m_calls{0};
+        std::atomic<uint64_t> m_successes{0};
+        std::atomic<uint64_t> m_failures{0};
+        std::atomic<uint64_t> m_delays{0};
+        std::atomic<uint64_t> m_callNanos{0};
+        std::atomic<uint64_t> m_maxCallNanos{0};
+        std::atomic<uint64_t> m_decoratorCalls{0};
+        std::atomic<uint64_t> m_decoratorFailures{0};
+        std::atomic<uint64_t> m_decoratorNanos{0};
+        std::atomic<uint64_t> m_maxDecoratorNanos{0};
+    };
+    void RecordCall(uint32_t node, int result, uint64_t nanos) const;
+    void RecordDecorator(uint32_t node, int result, uint64_t nanos) const;
+    // executors of a frozen context update these concurrently
+    mutable std::unique_ptr<NodeCounters[]> m_counters;
+    mutable std::atomic<uint64_t> m_updates{0};
+    mutable std::atomic<uint64_t> m_rebuilds{0};
+    mutable std::atomic<uint64_t> m_traversals{0};
+#endif
+    friend class TreeExecutor<C,LC,DC>;
+    friend class TreeSerializer<C,LC,DC>;
+    template <typename, typename, typename> friend class TraceReplay;
+};
+
+//
+// Tracing
+//
+
+enum class TraceEventType: uint32_t
+{
+    UPDATE,    // index: node stack depth when the update started
+    ADD_CHILD, // index: node
+    CALL,      // index: leaf or multiplexer node, result: callback result
+    DECORATOR, // index: decorator table entry, result: callback result
+    REBUILD,   // index: node stack index unwound to (-1 when the tree ends), result: reason
+    TRAVERSE,  // index: branch node, result: TraversalMode
+    SUSPEND,   // index: node about to be entered when the budget ran out
+    NOTIFY     // index: event a decorator is about to be re-evaluated on
+};
+
+struct TraceEvent
+{
+    uint64_t m_time; // "now" of the update the event happened in
+    TraceEventType m_type;
+    uint32_t m_index;
+    int32_t m_result;
+};
+
+// Fixed-size ring buffer an executor records its transitions into (see
+// TreeExecutor::SetTrace), overwriting the oldest events when full.
+// Recording never allocates or locks. Only the executor writes to it, but
+// Events may be called from any thread while it does.
+class TraceBuffer
+{
+public:
+    // capacity is rounded up to a power of two
+    TraceBuffer(size_t capacity);
+    void Record(uint64_t time, TraceEventType type, uint32_t index, int32_t result);
+    // Copies the retained events, oldest first
+    std::vector<TraceEvent> Events() const;
+    // Events recorded since construction, including overwritten ones
+    uint64_t Recorded() const;
+    size_t Capacity() const;
+    void Clear();
+private:
+    // fields are atomic so that Events can read slots being overwritten,
+    // which it then drops
+    struct Slot
+    {
+        std::atomic<uint64_t> m_time;
+        std::atomic<TraceEventType> m_type;
+        std::atomic<uint32_t> m_index;
+        std::atomic<int32_t> m_result;
+    };
+    std::unique_ptr<Slot[]> m_events;
+    size_t m_mask;
+    // events recorded, and events whose slot has started to be written
+    std::atomic<uint64_t> m_head{0};
+    std::atomic<uint64_t> m_claimed{0};
 };
 
 //
@@ -152,11 +576,84 @@ struct TreeTimer
     uint64_t m_delay = 0;
     uint64_t m_start = 0;
     bool HasPassed(uint64_t now);
+    uint64_t Deadline() const;
     void Set(uint64_t now, uint64_t delay);
     void Disable();
     void Clear();
 };
 
+// Work a budgeted TreeExecutor::Update may do before it suspends. An
+// executor and its multiplexer subtrees draw from the same budget, and one
+// budget may be passed to many executors in turn to split a frame's worth
+// of work between them. Not thread safe.
+struct UpdateBudget
+{
+    using Clock = std::chrono::steady_clock;
+    // node transitions (children entered) left
+    uint64_t m_transitions = UINT64_MAX;
+    // only checked every few transitions, as reading the clock is not free
+    Clock::time_point m_deadline = Clock::time_point::max();
+    uint32_t m_spent = 0;
+
+    // Consumes one transition, false once the budget has run out
+    bool Spend();
+    bool Exhausted() const;
+};
+
+// Results of per-tick callbacks in the current update, shared by an
+// executor and its multiplexer subtrees
+struct TreeMemo
+{
+    static constexpr uint32_t NO_MEMO = UINT32_MAX;
+    uint64_t m_epoch = 0;
+    std::vector<uint64_t> m_epochs;
+    std::vector<int> m_results;
+
+    // Invalidates all results
+    void Begin(uint32_t slots);
+    template <typename C, typename M>
+    int Call(uint32_t slot, std::function<int(C&,M&)> const& callback, C& ctx, M& memory);
+};
+
+// Memory of the typed leaves and decorators on an executors stacks (see
+// TypedCallback). Objects are constructed when pushed and destroyed when
+// popped, last in first out, so the slab only holds the memory of the
+// active path. Growing relocates live objects, copying a slab copies them
+// and throws if one of them cannot be copied.
+class TreeSlab
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    TreeSlab() = default;
+    TreeSlab(TreeSlab const& other);
+    TreeSlab(TreeSlab&& other) noexcept;
+    TreeSlab& operator=(TreeSlab const& other);
+    TreeSlab& operator=(TreeSlab&& other) noexcept;
+    ~TreeSlab();
+
+    // Constructs an object of "type", returns its offset
+    uint32_t Push(TreeMemoryType const& type);
+    void* At(uint32_t offset);
+    void const* At(uint32_t offset) const;
+    // Number of live objects, PopTo destroys those pushed after "mark"
+    size_t Mark() const;
+    void PopTo(size_t mark);
+    // Bytes used by live objects, and bytes allocated
+    size_t Size() const;
+    size_t Capacity() const;
+private:
+    struct Object
+    {
+        uint32_t m_offset;
+        TreeMemoryType const* m_type;
+    };
+    void Grow(size_t size);
+    std::unique_ptr<std::max_align_t[]> m_data;
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    std::vector<Object> m_objects;
+};
+
 template <typename DC>
 struct DecoratorStackEntry
 {
@@ -164,17 +661,101 @@ struct DecoratorStackEntry
     int m_nodeStackIndex;
     int m_decoratorIndex;
     TreeTimer m_timer;
+    // its event was notified since it was last evaluated
+    bool m_notified = false;
+    // typed decorators only
+    uint32_t m_slabOffset = TreeSlab::NONE;
 };
 
 template <typename C, typename LC, typename DC>
 struct NodeStackEntry
 {
-    Node<C,LC,DC>* m_node;
+    uint32_t m_node;
     LC m_memory;
     int m_decoStackSize;
     int m_ctr = 0;
     int m_loop = 0;
     int m_retry = 0;
+    // typed leaves only
+    uint32_t m_slabOffset = TreeSlab::NONE;
+    // TreeSlab::Mark once this entry was pushed, the slab is popped back to
+    // it when the stacks are unwound to this entry
+    uint32_t m_slabMark = 0;
+#ifdef BT_COROUTINES
+    // coroutine leaves only, started on their first execution
+    TreeTask m_task;
+#endif
+};
+
+// Stack storage used by executors. Either owns growable heap storage like a
+// std::vector, or borrows a fixed-capacity block of uninitialized memory
+// owned by someone else (see ExecutorPool). Copies always own their storage.
+template <typename T>
+class TreeStack
+{
+public:
+    TreeStack() = default;
+    TreeStack(T* storage, size_t capacity);
+    TreeStack(TreeStack const& other);
+    TreeStack(TreeStack&& other) noexcept;
+    TreeStack& operator=(TreeStack const& other);
+    TreeStack& operator=(TreeStack&& other) noexcept;
+    ~TreeStack();
+
+    size_t size() const;
+    size_t capacity() const;
+    T& operator[](size_t index);
+    T const& operator[](size_t index) const;
+    T& back();
+    T* begin();
+    T* end();
+    T const* begin() const;
+    T const* end() const;
+    void push_back(T const& value);
+    void push_back(T&& value);
+    void resize(size_t size);
+    void clear();
+    void reserve(size_t capacity);
+private:
+    void Release();
+    T* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    bool m_owned = true;
+};
+
+// Batched leaves queued by executors updated with this batch, grouped by
+// leaf so that Run calls each batched callback once for all executors
+// waiting on it. Queued executors must not be updated, moved or destroyed
+// until the batch has run.
+template <typename C, typename LC, typename DC>
+class LeafBatch
+{
+public:
+    // Calls every queued callback and hands the results to the executors
+    // waiting on them. Throws what a callback throws, the executors that
+    // did not get a result call their leaf on their own when next updated.
+    void Run();
+    // Executors waiting on a result
+    size_t Size() const;
+private:
+    using Context = std::remove_reference_t<C>;
+    struct Group
+    {
+        BatchLeafCallback<C,LC> const* m_callback = nullptr;
+        std::vector<Context*> m_contexts;
+        std::vector<LC*> m_memories;
+        std::vector<TreeExecutor<C,LC,DC>*> m_executors;
+        std::vector<int> m_results;
+    };
+    void Queue(BatchLeafCallback<C,LC> const* callback, TreeExecutor<C,LC,DC>* executor, C& ctx, LC& memory);
+    void Clear();
+    // groups past m_activeGroups are kept around for their capacity
+    std::vector<Group> m_groups;
+    size_t m_activeGroups = 0;
+    size_t m_size = 0;
+    friend class TreeExecutor<C,LC,DC>;
+    template <typename, typename, typename> friend class TreeScheduler;
 };
 
 template <typename C, typename LC, typename DC>
@@ -182,37 +763,250 @@ class TreeExecutor
 {
 public:
     TreeExecutor(BehaviorTreeContext<C,LC,DC>* ctx, Node<C,LC,DC>* root);
+    TreeExecutor(std::shared_ptr<CompiledTree<C,LC,DC> const> tree);
     void Update(C& ctx, uint64_t now);
+    // Runs until the tree waits on a delay or "budget" runs out, returns true
+    // in the latter case. The next Update, budgeted or not, resumes exactly
+    // where this one stopped.
+    bool Update(C& ctx, uint64_t now, UpdateBudget& budget);
+    // Like the budgeted Update, but batched leaves are queued into "batch"
+    // instead of being called, in which case the update suspends. Updating
+    // again once the batch has run continues it with the leaf's result.
+    bool Update(C& ctx, uint64_t now, UpdateBudget& budget, LeafBatch<C,LC,DC>& batch);
+    bool IsSuspended() const;
+    // True if the last update suspended on a batched leaf of this executor
+    // or one of its subtrees
+    bool IsWaitingOnBatch() const;
     size_t NodeStackDepth();
+    // Earliest time at which Update will do any work, 0 if any time will do.
+    uint64_t NextUpdateTime() const;
+    // Level of detail: after doing any work, Update does nothing until
+    // "interval" has passed, so running leaves and decorators are evaluated
+    // at most once per interval. Delays still end at their deadline, on the
+    // first update at or after it that the interval allows.
+    void SetTickInterval(uint64_t interval);
+    uint64_t TickInterval() const;
+    // True if this executor can run concurrently with others using the same nodes
+    bool IsThreadSafe() const;
+    // Records transitions of this executor and its subtrees into "trace",
+    // nullptr stops tracing. The buffer must outlive the executor.
+    void SetTrace(TraceBuffer* trace);
+    // Makes the next Update re-evaluate every active decorator subscribed
+    // to "event", and makes the executor due now as far as its tick interval
+    // allows. Decorators in multiplexer subtrees are re-evaluated the next
+    // time their subtree runs.
+    void Notify(TreeEventId event);
+    // Memory of the typed leaves and decorators this executor is running,
+    // not including its multiplexer subtrees
+    TreeSlab const& NodeMemory() const;
+    // Runs "root" instead of the current tree from now on, keeping the
+    // state of the running path as far as the new tree has the same path:
+    // the same child positions down from the root, leading to nodes of the
+    // same kind with the same loops and attempts, the same number of
+    // decorators, the same registered callback names, arguments and events
+    // and the same typed memory (and multiplexers with the same number of
+    // subtrees). The deepest node that still matches enters its current
+    // child again, or its first one if it has fewer children now, and a
+    // root that does not match starts over.
+    //
+    // Nodes whose callbacks are not registered never match, and neither do
+    // coroutine leaves. Trees built with builder lambdas or Lua functions
+    // therefore never keep leaf state across ReplaceTree; reloaded scripts
+    // only keep it where they use callbacks registered by name.
+    //
+    // Must not be called while waiting on a batch that has not run.
+    // Executors of an ExecutorPool only fit trees as deep as the one of the
+    // pool.
+    void ReplaceTree(Node<C,LC,DC>* root);
+    void ReplaceTree(std::shared_ptr<CompiledTree<C,LC,DC> const> tree);
+    // Node the executor was created with or last given to ReplaceTree,
+    // nullptr for executors of a compiled tree
+    Node<C,LC,DC>* RootNode() const;
+#ifdef BT_COROUTINES
+    // Pool the frames of this executors coroutine leaves come from
+    TreeFramePool const& FramePool() const;
+#endif
 private:
-    Node<C,LC,DC>* m_root;
-    BehaviorTreeContext<C, LC, DC>* m_ctx;
+    enum class Suspension: uint8_t
+    {
+        NONE,
+        ADD_CHILD, // m_resumeAt: child about to be entered
+        SUBTREES,  // m_resumeAt: first multiplexer subtree not updated yet
+        BATCH      // the leaf on top of m_nodeStack is queued in a LeafBatch
+    };
+
+    TreeExecutor(CompiledTree<C,LC,DC> const* tree, uint32_t root);
+    // "memo" is the parents for subtrees, top-level executors use m_memo
+    bool Step(C& ctx, uint64_t now, UpdateBudget* budget, TreeMemo* memo, LeafBatch<C,LC,DC>* batch);
+    bool UpdateSubtrees(C& ctx, uint64_t now, UpdateBudget* budget, TreeMemo* memo, LeafBatch<C,LC,DC>* batch, size_t first);
+    // Earliest time the tick interval allows the next update at
+    uint64_t NextTick() const;
+    // Earliest time a timer on the stacks runs out, 0 if the tree restarts
+    uint64_t NextDeadline() const;
+    void Reset(CompiledTree<C,LC,DC> const* tree, uint32_t root);
+    // moves the stacks of this executor and its subtrees onto "tree"
+    void Remap(CompiledTree<C,LC,DC> const* tree, uint32_t root);
+    static bool IsSameNode(CompiledTree<C,LC,DC> const& from, uint32_t a, CompiledTree<C,LC,DC> const& to, uint32_t b);
+    static bool IsSameSymbol(CallbackSymbol const& a, CallbackSymbol const& b);
+    void EnterSubtrees(CompiledNode const& multiplexer);
+    void LeaveSubtrees();
+    BehaviorTreeContext<C, LC, DC>* m_ctx = nullptr;
+    Node<C,LC,DC>* m_rootNode = nullptr;
+    // only set on top-level executors, subtrees borrow their parents tree
+    std::shared_ptr<CompiledTree<C,LC,DC> const> m_treeRef;
+    CompiledTree<C,LC,DC> const* m_tree = nullptr;
+    uint32_t m_root = 0;
     TreeTimer m_endTimer;
+    TraceBuffer* m_trace = nullptr;
+    bool m_subtree = false;
+    Suspension m_suspension = Suspension::NONE;
+    uint32_t m_resumeAt = 0;
+    // suspended on a batched leaf, here or in a subtree. Resuming continues
+    // the same update, without evaluating decorators again.
+    bool m_batchWait = false;
+    // set by LeafBatch::Run for an executor suspended on Suspension::BATCH
+    bool m_batchReady = false;
+    int m_batchResult = 0;
+    uint64_t m_tickInterval = 0;
+    uint64_t m_lastTick = 0;
+    bool m_ticked = false;
+    TreeMemo m_memo;
+    // subtrees of the running multiplexer come first, the rest are kept
+    // around so their stacks can be reused next time one is entered.
     std::vector<TreeExecutor<C,LC,DC>> m_subtrees;
-    std::vector<NodeStackEntry<C,LC,DC>> m_nodeStack;
-    std::vector<DecoratorStackEntry<DC>> m_decoratorStack;
+    size_t m_activeSubtrees = 0;
+#ifdef BT_COROUTINES
+    // frames of the coroutine leaves on m_nodeStack. Copied executors start
+    // with an empty pool, and restart the coroutine leaves they copied.
+    TreeFramePool m_framePool;
+#endif
+    TreeSlab m_slab;
+    TreeStack<NodeStackEntry<C,LC,DC>> m_nodeStack;
+    TreeStack<DecoratorStackEntry<DC>> m_decoratorStack;
     friend class BehaviorTreeContext<C,LC,DC>;
+    friend class TreeSerializer<C,LC,DC>;
+    template <typename, typename, typename> friend class ExecutorPool;
+    friend class LeafBatch<C,LC,DC>;
 };
 
 //
 // Context
 //
 
+// Outcome of BehaviorTreeContext::Intern
+struct InternStats
+{
+    size_t m_nodes = 0;      // nodes visited
+    size_t m_merged = 0;     // nodes replaced by an identical one
+    size_t m_bytesSaved = 0; // approximate size of the merged nodes
+};
+
+// Owns all nodes created through it.
+//
+// Nodes are normally allocated one by one. Nodes created between
+// BeginTreeArena and EndTreeArena are instead bump allocated (together with
+// their children and decorator lists) from an arena that can be released
+// on its own with ReleaseTreeArena, without touching any other tree. Nodes
+// must not be shared with AddNode across arenas that are released
+// separately. Executors keep running after their nodes are released, as
+// compiled trees hold their own copies of all callbacks.
+//
+// Thread safety: building trees is single-threaded. Once Freeze has been
+// called, every Create*, Add*, Decorate, SetLoops, SetAttempts and
+// DestroyAllNodes call throws instead, and the context, its nodes and its
+// compiled trees may be shared by executors running on any number of
+// threads. Compile is internally synchronized.
 template <typename C, typename LC, typename DC>
 class BehaviorTreeContext
 {
 public:
+    void Freeze();
+    bool IsFrozen() const;
     void DestroyAllNodes();
+
+    TreeArenaId BeginTreeArena(size_t initialSize = 4096);
+    void EndTreeArena();
+    void ReleaseTreeArena(TreeArenaId arena);
+    // Resource new nodes should allocate from
+    std::pmr::memory_resource* MemoryResource() const;
+
+    // Hash-conses identical subtrees: nodes of the same kind with the same
+    // registered callbacks and arguments, decorators, loops, attempts and
+    // (already merged) children become a single shared node. Nodes using
+    // callbacks that are not registered are only identical to themselves.
+    // Nodes are only merged with nodes of the same arena, or with other
+    // nodes outside of arenas, so arenas can still be released separately.
+    //
+    // Parents are pointed at the node a child was merged into, as are the
+    // entries of "roots". Merged nodes outside of arenas are destroyed, so
+    // no other pointer to them may be used afterwards. Merged arena nodes
+    // are destroyed with their arena.
+    InternStats Intern(std::vector<Node<C,LC,DC>*>& roots);
+    InternStats Intern();
+
     Branch<C,LC,DC>* CreateSequence();
     Multiplexer<C,LC,DC>* CreateMultiplexer(LeafCallback<C,LC> callback);
     Multiplexer<C,LC,DC>* CreateMultiplexer();
     Branch<C,LC,DC>* CreateSelector();
     Leaf<C,LC,DC>* CreateLeaf(LeafCallback<C,LC> exec);
+    template <typename M>
+    Leaf<C,LC,DC>* CreateTypedLeaf(std::function<int(C&,M&)> exec);
+    Leaf<C,LC,DC>* CreateBatchLeaf(BatchLeafCallback<C,LC> exec);
+#ifdef BT_COROUTINES
+    Leaf<C,LC,DC>* CreateCoroutineLeaf(CoroutineLeafCallback<C> coroutine);
+#endif
+    // Variants taking callbacks registered in Callbacks()
+    Leaf<C,LC,DC>* CreateLeaf(std::string const& name, CallbackArgs const& args = {});
+    Multiplexer<C,LC,DC>* CreateMultiplexer(std::string const& name, CallbackArgs const& args = {});
+    CallbackRegistry<C,LC,DC>& Callbacks();
     void VerifyNode(Node<C,LC,DC>* node);
+
+    // Returns the compiled form of the tree rooted at "root". Results are
+    // cached until any node in this context is modified.
+    std::shared_ptr<CompiledTree<C,LC,DC> const> Compile(Node<C,LC,DC>* root);
+#ifdef BT_PROFILING
+    // Counters of every tree currently compiled by this context. Counters
+    // of a tree are dropped when it is recompiled after a modification.
+    ProfileSnapshot Profile();
+    void ResetProfile();
+#endif
 private:
+    struct TreeArena
+    {
+        TreeArena(size_t initialSize);
+        ~TreeArena();
+        std::pmr::monotonic_buffer_resource m_resource;
+        std::pmr::vector<Node<C,LC,DC>*> m_nodes;
+    };
+    template <typename T, typename... Args>
+    T* CreateNode(std::vector<std::unique_ptr<T>>& owner, Args&&... args);
+    struct InternState
+    {
+        // arena of every node, UINT32_MAX for nodes outside of arenas
+        std::unordered_map<Node<C,LC,DC>*, TreeArenaId> m_arenas;
+        // node every visited node was merged into, itself if it was not
+        std::unordered_map<Node<C,LC,DC>*, Node<C,LC,DC>*> m_merged;
+        std::unordered_map<std::string, Node<C,LC,DC>*> m_canonical;
+    };
+    Node<C,LC,DC>* InternNode(Node<C,LC,DC>* node, InternState& state);
+    static std::pmr::vector<Node<C,LC,DC>*>* Children(Node<C,LC,DC>* node);
+    static size_t NodeBytes(Node<C,LC,DC>* node);
+
+    std::unordered_map<TreeArenaId, std::unique_ptr<TreeArena>> m_arenas;
+    TreeArena* m_activeArena = nullptr;
+    CallbackRegistry<C,LC,DC> m_callbacks;
+    TreeArenaId m_nextArena = 0;
     std::vector<std::unique_ptr<Leaf<C,LC,DC>>> m_leaves;
     std::vector<std::unique_ptr<Multiplexer<C,LC,DC>>> m_multiplexers;
     std::vector<std::unique_ptr<Branch<C,LC,DC>>> m_branches;
+    void OnModify();
+    bool m_frozen = false;
+    std::mutex m_compileMutex;
+    std::unordered_map<Node<C,LC,DC>*, std::shared_ptr<CompiledTree<C,LC,DC> const>> m_compiled;
+    // callbacks of the leaves created by CreateBatchLeaf
+    std::unordered_map<Node<C,LC,DC> const*, std::shared_ptr<BatchLeafCallback<C,LC> const>> m_batchLeaves;
+    friend class Node<C,LC,DC>;
+    friend class CompiledTree<C,LC,DC>;
 };
 
 #include "BehaviorTree.ipp"
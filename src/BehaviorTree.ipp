@@ -2,7 +2,15 @@
 
 #include "BehaviorTree.h"
 
+#include <algorithm>
+#include <map>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+#ifdef BT_PROFILING
+#include <chrono>
+#endif
 
 //
 // Constructors
@@ -12,41 +20,77 @@ template <typename C,typename LC,typename DC>
 Node<C,LC,DC>::~Node() {}
 
 template <typename C, typename LC, typename DC>
-Node<C,LC,DC>::Node(BehaviorTreeContext<C,LC,DC>* gen)
+Node<C,LC,DC>::Node(BehaviorTreeContext<C,LC,DC>* gen, NodeKind kind)
     : m_gen(gen)
+    , m_kind(kind)
+    , m_decorations(gen->MemoryResource())
+    , m_decorationSymbols(gen->MemoryResource())
+    , m_typedDecorations(gen->MemoryResource())
 {}
 
 template <typename C, typename LC, typename DC, typename T>
-DecorableNode<C,LC,DC, T>::DecorableNode(BehaviorTreeContext<C,LC,DC>* gen)
-    : Node<C,LC,DC>(gen)
+DecorableNode<C,LC,DC, T>::DecorableNode(BehaviorTreeContext<C,LC,DC>* gen, NodeKind kind)
+    : Node<C,LC,DC>(gen, kind)
 {
 
 }
 
 template <typename C, typename LC, typename DC>
 Leaf<C,LC,DC>::Leaf(BehaviorTreeContext<C,LC,DC>* gen, LeafCallback<C,LC> exec)
-    : DecorableNode<C,LC,DC,Leaf<C,LC,DC>>(gen), m_exec(exec)
+    : DecorableNode<C,LC,DC,Leaf<C,LC,DC>>(gen, NodeKind::LEAF), m_exec(std::move(exec))
 {
 
 }
 
+template <typename C, typename LC, typename DC>
+Leaf<C,LC,DC>::Leaf(BehaviorTreeContext<C,LC,DC>* gen, TypedCallback<C> typed)
+    : DecorableNode<C,LC,DC,Leaf<C,LC,DC>>(gen, NodeKind::LEAF), m_typed(std::move(typed))
+{
+
+}
+
+// Leaf callback running "batch" for a batch of one
+template <typename C, typename M>
+LeafCallback<C,M> BTBatchOfOne(std::shared_ptr<BatchLeafCallback<C,M> const> batch)
+{
+    // executors updated without a LeafBatch, and multiplexers, run the
+    // batch for themselves only
+    return [batch = std::move(batch)](C& ctx, M& memory) {
+        std::remove_reference_t<C>* context = &ctx;
+        M* memories = &memory;
+        int result = Result::FAILURE;
+        (*batch)(1, &context, &memories, &result);
+        return result;
+    };
+}
+
+#ifdef BT_COROUTINES
+template <typename C, typename LC, typename DC>
+Leaf<C,LC,DC>::Leaf(BehaviorTreeContext<C,LC,DC>* gen, CoroutineLeafCallback<C> coroutine)
+    : DecorableNode<C,LC,DC,Leaf<C,LC,DC>>(gen, NodeKind::COROUTINE_LEAF), m_coroutine(std::move(coroutine))
+{
+
+}
+#endif
+
 template <typename C, typename LC, typename DC>
 Multiplexer<C,LC,DC>::Multiplexer(BehaviorTreeContext<C,LC,DC>* gen, LeafCallback<C,LC> exec)
-    : BranchNode<C,LC,DC,Multiplexer<C,LC,DC>>(gen)
-    , m_callback(exec)
+    : BranchNode<C,LC,DC,Multiplexer<C,LC,DC>>(gen, NodeKind::MULTIPLEXER)
+    , m_callback(std::move(exec))
 {
 
 }
 
 template <typename C, typename LC, typename DC, typename T>
-BranchNode<C,LC,DC,T>::BranchNode(BehaviorTreeContext<C,LC,DC>* ctx)
-    : DecorableNode<C,LC,DC,T>(ctx)
+BranchNode<C,LC,DC,T>::BranchNode(BehaviorTreeContext<C,LC,DC>* ctx, NodeKind kind)
+    : DecorableNode<C,LC,DC,T>(ctx, kind)
+    , m_children(ctx->MemoryResource())
 {
 }
 
 template <typename C, typename LC, typename DC>
 Branch<C,LC,DC>::Branch(BehaviorTreeContext<C,LC,DC>* gen, BranchType type)
-    : BranchNode<C,LC,DC,Branch<C,LC,DC>>(gen)
+    : BranchNode<C,LC,DC,Branch<C,LC,DC>>(gen, type == BranchType::SEQUENCE ? NodeKind::SEQUENCE : NodeKind::SELECTOR)
     , m_type(type)
 {
 
@@ -55,6 +99,7 @@ Branch<C,LC,DC>::Branch(BehaviorTreeContext<C,LC,DC>* gen, BranchType type)
 template <typename C, typename LC, typename DC>
 Branch<C,LC,DC>* Branch<C,LC,DC>::SetLoops(uint64_t loops)
 {
+    this->OnModify();
     m_loops = loops;
     return this;
 }
@@ -62,6 +107,7 @@ Branch<C,LC,DC>* Branch<C,LC,DC>::SetLoops(uint64_t loops)
 template <typename C, typename LC, typename DC>
 Branch<C,LC,DC>* Branch<C,LC,DC>::SetAttempts(uint64_t attempts)
 {
+    this->OnModify();
     m_attempts = attempts;
     return this;
 }
@@ -69,142 +115,1903 @@ Branch<C,LC,DC>* Branch<C,LC,DC>::SetAttempts(uint64_t attempts)
 template <typename C, typename LC, typename DC>
 TreeExecutor<C,LC,DC>::TreeExecutor(BehaviorTreeContext<C,LC,DC>* ctx, Node<C,LC,DC>* root)
     : m_ctx(ctx)
+    , m_rootNode(root)
+{}
+
+template <typename C, typename LC, typename DC>
+TreeExecutor<C,LC,DC>::TreeExecutor(std::shared_ptr<CompiledTree<C,LC,DC> const> tree)
+    : m_treeRef(tree)
+    , m_tree(tree.get())
+{}
+
+template <typename C, typename LC, typename DC>
+TreeExecutor<C,LC,DC>::TreeExecutor(CompiledTree<C,LC,DC> const* tree, uint32_t root)
+    : m_tree(tree)
     , m_root(root)
 {}
 
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::Reset(CompiledTree<C,LC,DC> const* tree, uint32_t root)
+{
+    LeaveSubtrees();
+    m_tree = tree;
+    m_root = root;
+    m_suspension = Suspension::NONE;
+    m_endTimer.Clear();
+    m_nodeStack.clear();
+    m_decoratorStack.clear();
+    m_slab.PopTo(0);
+    m_batchWait = false;
+    m_batchReady = false;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::EnterSubtrees(CompiledNode const& multiplexer)
+{
+    LeaveSubtrees();
+    for (uint32_t i = multiplexer.m_childBegin; i < multiplexer.m_childEnd; ++i)
+    {
+        uint32_t root = m_tree->m_children[i];
+        if (m_activeSubtrees < m_subtrees.size())
+        {
+            m_subtrees[m_activeSubtrees].Reset(m_tree, root);
+        }
+        else
+        {
+            m_subtrees.push_back(TreeExecutor<C,LC,DC>(m_tree, root));
+            m_subtrees.back().m_subtree = true;
+        }
+        m_subtrees[m_activeSubtrees].SetTrace(m_trace);
+        m_activeSubtrees++;
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::LeaveSubtrees()
+{
+    // clearing releases leaf memory but keeps stack capacity around
+    for (size_t i = 0; i < m_activeSubtrees; ++i)
+    {
+        m_subtrees[i].Reset(m_tree, m_subtrees[i].m_root);
+    }
+    m_activeSubtrees = 0;
+}
+
 template <typename C, typename LC, typename DC>
 size_t TreeExecutor<C,LC,DC>::NodeStackDepth()
 {
     return m_nodeStack.size();
 }
 
-
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::Notify(TreeEventId event)
+{
+    for (DecoratorStackEntry<DC>& entry : m_decoratorStack)
+    {
+        CompiledNode const& decorated = m_tree->m_nodes[m_nodeStack[entry.m_nodeStackIndex].m_node];
+        if (m_tree->m_decoratorEvents[decorated.m_decoratorBegin + entry.m_decoratorIndex] == event)
+        {
+            entry.m_notified = true;
+        }
+    }
+    for (size_t i = 0; i < m_activeSubtrees; ++i)
+    {
+        m_subtrees[i].Notify(event);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+TreeSlab const& TreeExecutor<C,LC,DC>::NodeMemory() const
+{
+    return m_slab;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::SetTrace(TraceBuffer* trace)
+{
+    m_trace = trace;
+    for (size_t i = 0; i < m_activeSubtrees; ++i)
+    {
+        m_subtrees[i].SetTrace(trace);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::ReplaceTree(Node<C,LC,DC>* root)
+{
+    if (m_ctx == nullptr)
+    {
+        throw std::runtime_error("Executors of a compiled tree can only be given another compiled tree");
+    }
+    // executors that never ran compile their root on the first update
+    if (m_tree != nullptr)
+    {
+        ReplaceTree(m_ctx->Compile(root));
+    }
+    m_rootNode = root;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::ReplaceTree(std::shared_ptr<CompiledTree<C,LC,DC> const> tree)
+{
+    if (m_tree == nullptr)
+    {
+        m_tree = tree.get();
+    }
+    else
+    {
+        Remap(tree.get(), 0);
+    }
+    // the old tree is kept alive until the stacks no longer refer to it
+    m_treeRef = std::move(tree);
+    m_rootNode = nullptr;
+}
+
+template <typename C, typename LC, typename DC>
+Node<C,LC,DC>* TreeExecutor<C,LC,DC>::RootNode() const
+{
+    return m_rootNode;
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::IsSameNode(CompiledTree<C,LC,DC> const& from, uint32_t a, CompiledTree<C,LC,DC> const& to, uint32_t b)
+{
+    CompiledNode const& old = from.m_nodes[a];
+    CompiledNode const& node = to.m_nodes[b];
+    uint32_t decorators = old.m_decoratorEnd - old.m_decoratorBegin;
+    if (old.m_kind != node.m_kind || old.m_kind == NodeKind::COROUTINE_LEAF || decorators != node.m_decoratorEnd - node.m_decoratorBegin
+        || (old.m_callback == CompiledNode::NO_CALLBACK) != (node.m_callback == CompiledNode::NO_CALLBACK)
+        || old.m_loops != node.m_loops || old.m_attempts != node.m_attempts)
+    {
+        return false;
+    }
+    // subtrees are remapped one to one
+    if (old.m_kind == NodeKind::MULTIPLEXER && old.m_childEnd - old.m_childBegin != node.m_childEnd - node.m_childBegin)
+    {
+        return false;
+    }
+    if (old.m_callback != CompiledNode::NO_CALLBACK
+        && (!IsSameSymbol(from.m_callbackSymbols[old.m_callback], to.m_callbackSymbols[node.m_callback])
+            || from.m_typedCallbacks[old.m_callback].m_memory != to.m_typedCallbacks[node.m_callback].m_memory))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < decorators; ++i)
+    {
+        if (!IsSameSymbol(from.m_decoratorSymbols[old.m_decoratorBegin + i], to.m_decoratorSymbols[node.m_decoratorBegin + i])
+            || from.m_typedDecorators[old.m_decoratorBegin + i].m_memory != to.m_typedDecorators[node.m_decoratorBegin + i].m_memory)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// unnamed callbacks are lambdas that cannot be told apart
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::IsSameSymbol(CallbackSymbol const& a, CallbackSymbol const& b)
+{
+    return a.IsNamed() && b.IsNamed() && a.m_name == b.m_name && a.m_args == b.m_args && a.m_event == b.m_event;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::Remap(CompiledTree<C,LC,DC> const* tree, uint32_t root)
+{
+    CompiledTree<C,LC,DC> const& from = *m_tree;
+    CompiledTree<C,LC,DC> const& to = *tree;
+    // every entry below a branch is the child at the branches counter, so
+    // the path is followed down the new tree until it no longer matches
+    size_t kept = 0;
+    uint32_t node = root;
+    while (kept < m_nodeStack.size() && IsSameNode(from, m_nodeStack[kept].m_node, to, node))
+    {
+        NodeStackEntry<C,LC,DC>& entry = m_nodeStack[kept++];
+        entry.m_node = node;
+        CompiledNode const& branch = to.m_nodes[node];
+        if (kept == m_nodeStack.size() || uint32_t(entry.m_ctr) >= branch.m_childEnd - branch.m_childBegin)
+        {
+            break;
+        }
+        node = to.m_children[branch.m_childBegin + entry.m_ctr];
+    }
+    if (kept == 0)
+    {
+        Reset(tree, root);
+        return;
+    }
+
+    m_tree = tree;
+    m_root = root;
+    if (kept < m_nodeStack.size())
+    {
+        // unwound like a rebuild, but the deepest matching entry enters
+        // its current child again instead of moving on
+        LeaveSubtrees();
+        m_nodeStack.resize(kept);
+        m_decoratorStack.resize(m_nodeStack.back().m_decoStackSize);
+        m_slab.PopTo(m_nodeStack.back().m_slabMark);
+        m_endTimer.Clear();
+        m_batchWait = false;
+        m_batchReady = false;
+        m_suspension = Suspension::ADD_CHILD;
+    }
+    NodeStackEntry<C,LC,DC>& top = m_nodeStack.back();
+    CompiledNode const& topNode = to.m_nodes[top.m_node];
+    if (m_suspension == Suspension::ADD_CHILD)
+    {
+        if (uint32_t(top.m_ctr) >= topNode.m_childEnd - topNode.m_childBegin)
+        {
+            top.m_ctr = 0;
+        }
+        m_resumeAt = to.m_children[topNode.m_childBegin + top.m_ctr];
+    }
+    else if (topNode.m_kind == NodeKind::MULTIPLEXER)
+    {
+        for (size_t i = 0; i < m_activeSubtrees; ++i)
+        {
+            m_subtrees[i].Remap(tree, to.m_children[topNode.m_childBegin + i]);
+        }
+    }
+}
+
+//
+// Stacks
+//
+
+template <typename T>
+TreeStack<T>::TreeStack(T* storage, size_t capacity)
+    : m_data(storage)
+    , m_capacity(capacity)
+    , m_owned(false)
+{}
+
+template <typename T>
+TreeStack<T>::TreeStack(TreeStack const& other)
+{
+    reserve(other.m_size);
+    for (T const& value : other)
+    {
+        push_back(value);
+    }
+}
+
+template <typename T>
+TreeStack<T>::TreeStack(TreeStack&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+    , m_capacity(other.m_capacity)
+    , m_owned(other.m_owned)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+    other.m_owned = true;
+}
+
+template <typename T>
+TreeStack<T>& TreeStack<T>::operator=(TreeStack const& other)
+{
+    if (this != &other)
+    {
+        clear();
+        reserve(other.m_size);
+        for (T const& value : other)
+        {
+            push_back(value);
+        }
+    }
+    return *this;
+}
+
+template <typename T>
+TreeStack<T>& TreeStack<T>::operator=(TreeStack&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        m_owned = other.m_owned;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_capacity = 0;
+        other.m_owned = true;
+    }
+    return *this;
+}
+
+template <typename T>
+TreeStack<T>::~TreeStack()
+{
+    Release();
+}
+
+template <typename T>
+void TreeStack<T>::Release()
+{
+    clear();
+    if (m_owned && m_data)
+    {
+        std::allocator<T>().deallocate(m_data, m_capacity);
+    }
+    m_data = nullptr;
+    m_capacity = 0;
+}
+
+template <typename T>
+size_t TreeStack<T>::size() const
+{
+    return m_size;
+}
+
+template <typename T>
+size_t TreeStack<T>::capacity() const
+{
+    return m_capacity;
+}
+
+template <typename T>
+T& TreeStack<T>::operator[](size_t index)
+{
+    return m_data[index];
+}
+
+template <typename T>
+T const& TreeStack<T>::operator[](size_t index) const
+{
+    return m_data[index];
+}
+
+template <typename T>
+T& TreeStack<T>::back()
+{
+    return m_data[m_size - 1];
+}
+
+template <typename T>
+T* TreeStack<T>::begin()
+{
+    return m_data;
+}
+
+template <typename T>
+T* TreeStack<T>::end()
+{
+    return m_data + m_size;
+}
+
+template <typename T>
+T const* TreeStack<T>::begin() const
+{
+    return m_data;
+}
+
+template <typename T>
+T const* TreeStack<T>::end() const
+{
+    return m_data + m_size;
+}
+
+template <typename T>
+void TreeStack<T>::push_back(T const& value)
+{
+    if (m_size == m_capacity)
+    {
+        reserve(std::max<size_t>(8, m_capacity * 2));
+    }
+    new (m_data + m_size) T(value);
+    m_size++;
+}
+
+template <typename T>
+void TreeStack<T>::push_back(T&& value)
+{
+    if (m_size == m_capacity)
+    {
+        reserve(std::max<size_t>(8, m_capacity * 2));
+    }
+    new (m_data + m_size) T(std::move(value));
+    m_size++;
+}
+
+template <typename T>
+void TreeStack<T>::resize(size_t size)
+{
+    while (m_size > size)
+    {
+        m_data[--m_size].~T();
+    }
+    reserve(size);
+    while (m_size < size)
+    {
+        new (m_data + m_size) T();
+        m_size++;
+    }
+}
+
+template <typename T>
+void TreeStack<T>::clear()
+{
+    resize(0);
+}
+
+template <typename T>
+void TreeStack<T>::reserve(size_t capacity)
+{
+    if (capacity <= m_capacity)
+    {
+        return;
+    }
+    if (!m_owned)
+    {
+        throw std::runtime_error("TreeStack exceeded its fixed capacity");
+    }
+    T* data = std::allocator<T>().allocate(capacity);
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        new (data + i) T(std::move(m_data[i]));
+        m_data[i].~T();
+    }
+    if (m_data)
+    {
+        std::allocator<T>().deallocate(m_data, m_capacity);
+    }
+    m_data = data;
+    m_capacity = capacity;
+}
+
+//
+// Typed Memory
+//
+
+template <typename M>
+TreeMemoryType const* TreeMemoryType::Of()
+{
+    static_assert(std::is_default_constructible_v<M>, "Typed node memory must be default constructible");
+    static_assert(std::is_nothrow_move_constructible_v<M>, "Typed node memory must be nothrow move constructible");
+    static_assert(alignof(M) <= alignof(std::max_align_t), "Typed node memory cannot be over-aligned");
+    void (*copy)(void*, void const*) = nullptr;
+    if constexpr (std::is_copy_constructible_v<M>)
+    {
+        copy = [](void* to, void const* from) { new (to) M(*static_cast<M const*>(from)); };
+    }
+    static TreeMemoryType const type = {
+        sizeof(M),
+        alignof(M),
+        [](void* memory) { new (memory) M(); },
+        [](void* memory) { static_cast<M*>(memory)->~M(); },
+        [](void* to, void* from) {
+            new (to) M(std::move(*static_cast<M*>(from)));
+            static_cast<M*>(from)->~M();
+        },
+        copy
+    };
+    return &type;
+}
+
+template <typename C>
+template <typename M>
+TypedCallback<C> TypedCallback<C>::Of(std::function<int(C&,M&)> callback)
+{
+    TypedCallback<C> typed;
+    typed.m_callback = [callback = std::move(callback)](C& ctx, void* memory) {
+        return callback(ctx, *static_cast<M*>(memory));
+    };
+    typed.m_memory = TreeMemoryType::Of<M>();
+    return typed;
+}
+
+inline TreeSlab::TreeSlab(TreeSlab const& other)
+{
+    if (other.m_size > 0)
+    {
+        Grow(other.m_size);
+    }
+    m_objects.reserve(other.m_objects.size());
+    for (Object const& object : other.m_objects)
+    {
+        if (object.m_type->m_copy == nullptr)
+        {
+            PopTo(0);
+            throw std::runtime_error("Typed node memory cannot be copied");
+        }
+        object.m_type->m_copy(At(object.m_offset), other.At(object.m_offset));
+        m_objects.push_back(object);
+        m_size = object.m_offset + object.m_type->m_size;
+    }
+}
+
+inline TreeSlab::TreeSlab(TreeSlab&& other) noexcept
+    : m_data(std::move(other.m_data))
+    , m_capacity(std::exchange(other.m_capacity, 0))
+    , m_size(std::exchange(other.m_size, 0))
+    , m_objects(std::move(other.m_objects))
+{
+    other.m_objects.clear();
+}
+
+inline TreeSlab& TreeSlab::operator=(TreeSlab const& other)
+{
+    if (this != &other)
+    {
+        *this = TreeSlab(other);
+    }
+    return *this;
+}
+
+inline TreeSlab& TreeSlab::operator=(TreeSlab&& other) noexcept
+{
+    if (this != &other)
+    {
+        PopTo(0);
+        m_data = std::move(other.m_data);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_size = std::exchange(other.m_size, 0);
+        m_objects = std::move(other.m_objects);
+        other.m_objects.clear();
+    }
+    return *this;
+}
+
+inline TreeSlab::~TreeSlab()
+{
+    PopTo(0);
+}
+
+inline uint32_t TreeSlab::Push(TreeMemoryType const& type)
+{
+    size_t offset = (m_size + type.m_align - 1) / type.m_align * type.m_align;
+    if (offset + type.m_size > m_capacity)
+    {
+        Grow(std::max(offset + type.m_size, m_capacity * 2));
+    }
+    m_objects.reserve(m_objects.size() + 1);
+    type.m_construct(At(uint32_t(offset)));
+    m_objects.push_back({ uint32_t(offset), &type });
+    m_size = offset + type.m_size;
+    return uint32_t(offset);
+}
+
+inline void* TreeSlab::At(uint32_t offset)
+{
+    return reinterpret_cast<std::byte*>(m_data.get()) + offset;
+}
+
+inline void const* TreeSlab::At(uint32_t offset) const
+{
+    return reinterpret_cast<std::byte const*>(m_data.get()) + offset;
+}
+
+inline size_t TreeSlab::Mark() const
+{
+    return m_objects.size();
+}
+
+inline void TreeSlab::PopTo(size_t mark)
+{
+    while (m_objects.size() > mark)
+    {
+        Object const& object = m_objects.back();
+        object.m_type->m_destroy(At(object.m_offset));
+        m_size = object.m_offset;
+        m_objects.pop_back();
+    }
+}
+
+inline size_t TreeSlab::Size() const
+{
+    return m_size;
+}
+
+inline size_t TreeSlab::Capacity() const
+{
+    return m_capacity;
+}
+
+inline void TreeSlab::Grow(size_t size)
+{
+    size_t count = (size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+    std::unique_ptr<std::max_align_t[]> data(new std::max_align_t[count]);
+    for (Object const& object : m_objects)
+    {
+        object.m_type->m_relocate(reinterpret_cast<std::byte*>(data.get()) + object.m_offset, At(object.m_offset));
+    }
+    m_data = std::move(data);
+    m_capacity = count * sizeof(std::max_align_t);
+}
+
+template <typename C, typename LC, typename DC>
+uint64_t TreeExecutor<C,LC,DC>::NextUpdateTime() const
+{
+    if (m_suspension != Suspension::NONE)
+    {
+        return 0;
+    }
+    return std::max(NextDeadline(), NextTick());
+}
+
+template <typename C, typename LC, typename DC>
+uint64_t TreeExecutor<C,LC,DC>::NextDeadline() const
+{
+    if (m_nodeStack.size() == 0)
+    {
+        return 0;
+    }
+    // subtrees only run once the multiplexers end timer has passed
+    uint64_t next = m_endTimer.Deadline();
+    for (DecoratorStackEntry<DC> const& entry : m_decoratorStack)
+    {
+        next = std::min(next, entry.m_notified ? 0 : entry.m_timer.Deadline());
+    }
+    return next;
+}
+
+template <typename C, typename LC, typename DC>
+uint64_t TreeExecutor<C,LC,DC>::NextTick() const
+{
+    if (m_tickInterval == 0 || !m_ticked)
+    {
+        return 0;
+    }
+    return m_tickInterval > UINT64_MAX - m_lastTick ? UINT64_MAX : m_lastTick + m_tickInterval;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeExecutor<C,LC,DC>::SetTickInterval(uint64_t interval)
+{
+    m_tickInterval = interval;
+}
+
+template <typename C, typename LC, typename DC>
+uint64_t TreeExecutor<C,LC,DC>::TickInterval() const
+{
+    return m_tickInterval;
+}
+
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::IsThreadSafe() const
+{
+    return m_ctx == nullptr || m_ctx->IsFrozen();
+}
+
+
+//
+// Creator Methods
+//
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::Freeze()
+{
+    m_frozen = true;
+}
+
+template <typename C, typename LC, typename DC>
+bool BehaviorTreeContext<C,LC,DC>::IsFrozen() const
+{
+    return m_frozen;
+}
+
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::OnModify()
+{
+    if (m_frozen)
+    {
+        throw std::runtime_error("Cannot modify a frozen BehaviorTreeContext");
+    }
+    m_compiled.clear();
+}
+
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::DestroyAllNodes()
+{
+    OnModify();
+    m_activeArena = nullptr;
+    m_arenas.clear();
+    m_leaves.clear();
+    m_multiplexers.clear();
+    m_branches.clear();
+    m_batchLeaves.clear();
+}
+
+template <typename C, typename LC, typename DC>
+BehaviorTreeContext<C,LC,DC>::TreeArena::TreeArena(size_t initialSize)
+    : m_resource(initialSize)
+    , m_nodes(&m_resource)
+{}
+
+template <typename C, typename LC, typename DC>
+BehaviorTreeContext<C,LC,DC>::TreeArena::~TreeArena()
+{
+    // memory itself is released all at once by m_resource
+    for (size_t i = m_nodes.size(); i > 0; --i)
+    {
+        m_nodes[i - 1]->~Node();
+    }
+}
+
+template <typename C, typename LC, typename DC>
+TreeArenaId BehaviorTreeContext<C,LC,DC>::BeginTreeArena(size_t initialSize)
+{
+    OnModify();
+    if (m_activeArena)
+    {
+        throw std::runtime_error("BeginTreeArena called while another arena is active");
+    }
+    TreeArenaId id = m_nextArena++;
+    m_activeArena = (m_arenas[id] = std::make_unique<TreeArena>(initialSize)).get();
+    return id;
+}
+
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::EndTreeArena()
+{
+    m_activeArena = nullptr;
+}
+
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::ReleaseTreeArena(TreeArenaId arena)
+{
+    OnModify();
+    auto itr = m_arenas.find(arena);
+    if (itr == m_arenas.end())
+    {
+        throw std::runtime_error("Releasing unknown tree arena");
+    }
+    if (itr->second.get() == m_activeArena)
+    {
+        m_activeArena = nullptr;
+    }
+    // a node created later could reuse the address of a released one
+    for (Node<C,LC,DC>* node : itr->second->m_nodes)
+    {
+        m_batchLeaves.erase(node);
+    }
+    m_arenas.erase(itr);
+}
+
+template <typename C, typename LC, typename DC>
+std::pmr::memory_resource* BehaviorTreeContext<C,LC,DC>::MemoryResource() const
+{
+    return m_activeArena ? &m_activeArena->m_resource : std::pmr::get_default_resource();
+}
+
+//
+// Interning
+//
+
+template <typename C, typename LC, typename DC>
+InternStats BehaviorTreeContext<C,LC,DC>::Intern()
+{
+    std::vector<Node<C,LC,DC>*> roots;
+    return Intern(roots);
+}
+
+template <typename C, typename LC, typename DC>
+InternStats BehaviorTreeContext<C,LC,DC>::Intern(std::vector<Node<C,LC,DC>*>& roots)
+{
+    OnModify();
+    InternState state;
+    std::vector<Node<C,LC,DC>*> nodes;
+    auto add = [&](Node<C,LC,DC>* node, TreeArenaId arena) {
+        state.m_arenas.emplace(node, arena);
+        nodes.push_back(node);
+    };
+    for (auto const& leaf : m_leaves) add(leaf.get(), UINT32_MAX);
+    for (auto const& multiplexer : m_multiplexers) add(multiplexer.get(), UINT32_MAX);
+    for (auto const& branch : m_branches) add(branch.get(), UINT32_MAX);
+    for (auto const& arena : m_arenas)
+    {
+        for (Node<C,LC,DC>* node : arena.second->m_nodes)
+        {
+            add(node, arena.first);
+        }
+    }
+
+    // roots first, so they are the ones identical nodes are merged into
+    for (Node<C,LC,DC>* root : roots)
+    {
+        InternNode(root, state);
+    }
+    for (Node<C,LC,DC>* node : nodes)
+    {
+        InternNode(node, state);
+    }
+
+    InternStats stats;
+    stats.m_nodes = nodes.size();
+    auto merged = [&](Node<C,LC,DC>* node) {
+        auto itr = state.m_merged.find(node);
+        return itr == state.m_merged.end() ? node : itr->second;
+    };
+    for (Node<C,LC,DC>* node : nodes)
+    {
+        if (merged(node) != node)
+        {
+            stats.m_merged++;
+            stats.m_bytesSaved += NodeBytes(node);
+        }
+        else if (std::pmr::vector<Node<C,LC,DC>*>* children = Children(node))
+        {
+            // cycles can leave children pointing at nodes merged later
+            for (Node<C,LC,DC>*& child : *children)
+            {
+                child = merged(child);
+            }
+        }
+    }
+    for (Node<C,LC,DC>*& root : roots)
+    {
+        root = merged(root);
+    }
+
+    auto erase = [&](auto& owner) {
+        owner.erase(std::remove_if(owner.begin(), owner.end(), [&](auto const& node) { return merged(node.get()) != node.get(); }), owner.end());
+    };
+    erase(m_leaves);
+    erase(m_multiplexers);
+    erase(m_branches);
+    return stats;
+}
+
+template <typename C, typename LC, typename DC>
+Node<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::InternNode(Node<C,LC,DC>* node, InternState& state)
+{
+    auto arena = state.m_arenas.find(node);
+    if (arena == state.m_arenas.end())
+    {
+        // not created by this context
+        return node;
+    }
+    auto visited = state.m_merged.emplace(node, node);
+    if (!visited.second)
+    {
+        // a node being interned is only reached again through a cycle
+        return visited.first->second;
+    }
+
+    std::string key;
+    bool internable = true;
+    auto append = [&](void const* data, size_t size) {
+        key.append(static_cast<char const*>(data), size);
+    };
+    auto appendSymbol = [&](CallbackSymbol const& symbol) {
+        internable = internable && symbol.IsNamed();
+        uint64_t sizes[3] = { symbol.m_name.size(), symbol.m_args.size(), symbol.m_event.size() };
+        append(sizes, sizeof(sizes));
+        key += symbol.m_name;
+        append(symbol.m_args.data(), sizeof(double) * symbol.m_args.size());
+        key += symbol.m_event;
+    };
+    append(&arena->second, sizeof(arena->second));
+    append(&node->m_kind, sizeof(node->m_kind));
+    for (CallbackSymbol const& symbol : node->m_decorationSymbols)
+    {
+        appendSymbol(symbol);
+    }
+    switch (node->m_kind)
+    {
+    case NodeKind::LEAF:
+        appendSymbol(static_cast<Leaf<C,LC,DC>*>(node)->m_symbol);
+        break;
+    case NodeKind::MULTIPLEXER:
+    {
+        Multiplexer<C,LC,DC>* multiplexer = static_cast<Multiplexer<C,LC,DC>*>(node);
+        if (multiplexer->m_callback)
+        {
+            appendSymbol(multiplexer->m_symbol);
+        }
+        break;
+    }
+    case NodeKind::SEQUENCE:
+    case NodeKind::SELECTOR:
+    {
+        Branch<C,LC,DC>* branch = static_cast<Branch<C,LC,DC>*>(node);
+        append(&branch->m_loops, sizeof(branch->m_loops));
+        append(&branch->m_attempts, sizeof(branch->m_attempts));
+        break;
+    }
+    default:
+        internable = false;
+        break;
+    }
+    if (std::pmr::vector<Node<C,LC,DC>*>* children = Children(node))
+    {
+        uint64_t count = children->size();
+        append(&count, sizeof(count));
+        for (Node<C,LC,DC>*& child : *children)
+        {
+            child = InternNode(child, state);
+            append(&child, sizeof(child));
+        }
+    }
+    if (!internable)
+    {
+        return node;
+    }
+    Node<C,LC,DC>* canonical = state.m_canonical.emplace(std::move(key), node).first->second;
+    state.m_merged[node] = canonical;
+    return canonical;
+}
+
+template <typename C, typename LC, typename DC>
+std::pmr::vector<Node<C,LC,DC>*>* BehaviorTreeContext<C,LC,DC>::Children(Node<C,LC,DC>* node)
+{
+    switch (node->m_kind)
+    {
+    case NodeKind::MULTIPLEXER:
+        return &static_cast<Multiplexer<C,LC,DC>*>(node)->m_children;
+    case NodeKind::SEQUENCE:
+    case NodeKind::SELECTOR:
+        return &static_cast<Branch<C,LC,DC>*>(node)->m_children;
+    default:
+        return nullptr;
+    }
+}
+
+template <typename C, typename LC, typename DC>
+size_t BehaviorTreeContext<C,LC,DC>::NodeBytes(Node<C,LC,DC>* node)
+{
+    size_t bytes = node->m_decorations.capacity() * sizeof(DecoratorCallback<C,DC>)
+        + node->m_decorationSymbols.capacity() * sizeof(CallbackSymbol);
+    if (std::pmr::vector<Node<C,LC,DC>*>* children = Children(node))
+    {
+        bytes += children->capacity() * sizeof(Node<C,LC,DC>*);
+    }
+    switch (node->m_kind)
+    {
+    case NodeKind::MULTIPLEXER:
+        return bytes + sizeof(Multiplexer<C,LC,DC>);
+    case NodeKind::SEQUENCE:
+    case NodeKind::SELECTOR:
+        return bytes + sizeof(Branch<C,LC,DC>);
+    default:
+        return bytes + sizeof(Leaf<C,LC,DC>);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+template <typename T, typename... Args>
+T* BehaviorTreeContext<C,LC,DC>::CreateNode(std::vector<std::unique_ptr<T>>& owner, Args&&... args)
+{
+    OnModify();
+    if (m_activeArena)
+    {
+        std::pmr::polymorphic_allocator<T> allocator(&m_activeArena->m_resource);
+        T* node = allocator.allocate(1);
+        new (node) T(this, std::forward<Args>(args)...);
+        m_activeArena->m_nodes.push_back(node);
+        return node;
+    }
+    return owner.emplace_back(std::make_unique<T>(this, std::forward<Args>(args)...)).get();
+}
+
+template <typename C, typename LC, typename DC>
+Branch<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateSequence()
+{
+    return CreateNode(m_branches, BranchType::SEQUENCE);
+}
+
+template <typename C, typename LC, typename DC>
+Branch<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateSelector()
+{
+    return CreateNode(m_branches, BranchType::SELECTOR);
+}
+
+template <typename C, typename LC, typename DC>
+Multiplexer<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateMultiplexer(LeafCallback<C,LC> callback)
+{
+    return CreateNode(m_multiplexers, std::move(callback));
+}
+
+template <typename C, typename LC, typename DC>
+Multiplexer<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateMultiplexer()
+{
+    return CreateNode(m_multiplexers);
+}
+
+template <typename C, typename LC, typename DC>
+Leaf<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateLeaf(LeafCallback<C,LC> exec)
+{
+    return CreateNode(m_leaves, std::move(exec));
+}
+
+template <typename C, typename LC, typename DC>
+Leaf<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateBatchLeaf(BatchLeafCallback<C,LC> exec)
+{
+    auto batch = std::make_shared<BatchLeafCallback<C,LC> const>(std::move(exec));
+    Leaf<C,LC,DC>* leaf = CreateLeaf(BTBatchOfOne<C,LC>(batch));
+    m_batchLeaves.emplace(leaf, std::move(batch));
+    return leaf;
+}
+
+template <typename C, typename LC, typename DC>
+template <typename M>
+Leaf<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateTypedLeaf(std::function<int(C&,M&)> exec)
+{
+    return CreateNode(m_leaves, TypedCallback<C>::template Of<M>(std::move(exec)));
+}
+
+#ifdef BT_COROUTINES
+template <typename C, typename LC, typename DC>
+Leaf<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateCoroutineLeaf(CoroutineLeafCallback<C> coroutine)
+{
+    return CreateNode(m_leaves, std::move(coroutine));
+}
+#endif
+
+template <typename C, typename LC, typename DC>
+Leaf<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateLeaf(std::string const& name, CallbackArgs const& args)
+{
+    Leaf<C,LC,DC>* leaf = CreateLeaf(m_callbacks.GetLeaf(name, args));
+    leaf->m_symbol = { name, args };
+    return leaf;
+}
+
+template <typename C, typename LC, typename DC>
+Multiplexer<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateMultiplexer(std::string const& name, CallbackArgs const& args)
+{
+    Multiplexer<C,LC,DC>* multiplexer = CreateMultiplexer(m_callbacks.GetLeaf(name, args));
+    multiplexer->m_symbol = { name, args };
+    return multiplexer;
+}
+
+template <typename C, typename LC, typename DC>
+CallbackRegistry<C,LC,DC>& BehaviorTreeContext<C,LC,DC>::Callbacks()
+{
+    return m_callbacks;
+}
+
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::VerifyNode(Node<C,LC,DC>* node)
+{
+}
+
+template <typename C, typename LC, typename DC>
+std::shared_ptr<CompiledTree<C,LC,DC> const> BehaviorTreeContext<C,LC,DC>::Compile(Node<C,LC,DC>* root)
+{
+    std::lock_guard<std::mutex> lock(m_compileMutex);
+    auto itr = m_compiled.find(root);
+    if (itr != m_compiled.end())
+    {
+        return itr->second;
+    }
+    return m_compiled[root] = std::make_shared<CompiledTree<C,LC,DC> const>(root);
+}
+
+template <typename C, typename LC, typename DC>
+void Node<C,LC,DC>::OnModify()
+{
+    m_gen->OnModify();
+}
+
+//
+// Compilation
+//
+
+template <typename C, typename LC, typename DC>
+CompiledTree<C,LC,DC>::CompiledTree(Node<C,LC,DC>* root)
+{
+    std::unordered_map<Node<C,LC,DC>*, uint32_t> indices;
+    Compile(root, indices);
+    Finalize(m_nodeStorage.data(), m_nodeStorage.size(), m_childStorage.data());
+}
+
+template <typename C, typename LC, typename DC>
+void CompiledTree<C,LC,DC>::AssignMemos()
+{
+    // leaves and decorators are registered separately, so are their slots
+    using Key = std::pair<std::string, CallbackArgs>;
+    auto assign = [&](std::vector<CallbackSymbol> const& symbols, std::vector<uint32_t>& memos) {
+        std::map<Key, uint32_t> slots;
+        memos.assign(symbols.size(), TreeMemo::NO_MEMO);
+        for (size_t i = 0; i < symbols.size(); ++i)
+        {
+            if (symbols[i].m_perTick)
+            {
+                auto inserted = slots.emplace(Key(symbols[i].m_name, symbols[i].m_args), m_memoCount);
+                if (inserted.second)
+                {
+                    m_memoCount++;
+                }
+                memos[i] = inserted.first->second;
+            }
+        }
+    };
+    m_memoCount = 0;
+    assign(m_callbackSymbols, m_callbackMemos);
+    assign(m_decoratorSymbols, m_decoratorMemos);
+}
+
+template <typename C, typename LC, typename DC>
+void CompiledTree<C,LC,DC>::Finalize(CompiledNode const* nodes, size_t nodeCount, uint32_t const* children)
+{
+    m_nodes = nodes;
+    m_nodeCount = nodeCount;
+    m_children = children;
+
+    std::vector<uint8_t> state(m_nodeCount, 0);
+    std::vector<uint32_t> nodeDepth(m_nodeCount, 0);
+    std::vector<uint32_t> decoratorDepth(m_nodeCount, 0);
+    ComputeDepth(0, state, nodeDepth, decoratorDepth);
+    m_maxNodeDepth = nodeDepth[0];
+    m_maxDecoratorDepth = decoratorDepth[0];
+    // only filled up to the last typed callback while compiling
+    m_typedCallbacks.resize(m_callbacks.size());
+    m_typedDecorators.resize(m_decorators.size());
+    m_batchCallbacks.resize(m_callbacks.size());
+    AssignMemos();
+#ifdef BT_PROFILING
+    m_counters.reset(new NodeCounters[m_nodeCount]);
+#endif
+}
+
+template <typename C, typename LC, typename DC>
+size_t CompiledTree<C,LC,DC>::NodeCount() const
+{
+    return m_nodeCount;
+}
+
+template <typename C, typename LC, typename DC>
+uint32_t CompiledTree<C,LC,DC>::MaxNodeDepth() const
+{
+    return m_maxNodeDepth;
+}
+
+template <typename C, typename LC, typename DC>
+uint32_t CompiledTree<C,LC,DC>::MaxDecoratorDepth() const
+{
+    return m_maxDecoratorDepth;
+}
+
+template <typename C, typename LC, typename DC>
+void CompiledTree<C,LC,DC>::ComputeDepth(uint32_t root, std::vector<uint8_t>& state, std::vector<uint32_t>& nodeDepth, std::vector<uint32_t>& decoratorDepth)
+{
+    enum { UNVISITED, VISITING, DONE };
+    // loaded trees can be arbitrarily deep, so the walk keeps its own stack
+    struct Frame
+    {
+        uint32_t m_node;
+        uint32_t m_next;
+        uint32_t m_childNodes;
+        uint32_t m_childDecorators;
+    };
+    std::vector<Frame> stack;
+    state[root] = VISITING;
+    stack.push_back({ root, m_nodes[root].m_childBegin, 0, 0 });
+    while (stack.size() > 0)
+    {
+        Frame& frame = stack.back();
+        CompiledNode const& compiled = m_nodes[frame.m_node];
+        bool branch = compiled.m_kind == NodeKind::SEQUENCE || compiled.m_kind == NodeKind::SELECTOR;
+        if (branch && frame.m_next < compiled.m_childEnd)
+        {
+            uint32_t child = m_children[frame.m_next];
+            if (state[child] == UNVISITED)
+            {
+                // combined with this frame once it is done
+                state[child] = VISITING;
+                stack.push_back({ child, m_nodes[child].m_childBegin, 0, 0 });
+                continue;
+            }
+            if (state[child] == VISITING)
+            {
+                // reached through AddNode cycle
+                nodeDepth[child] = UNBOUNDED;
+                decoratorDepth[child] = UNBOUNDED;
+            }
+            // a cycle may have marked us while visiting children
+            if (nodeDepth[frame.m_node] == UNBOUNDED || nodeDepth[child] == UNBOUNDED)
+            {
+                frame.m_childNodes = UNBOUNDED;
+                frame.m_childDecorators = UNBOUNDED;
+                frame.m_next = compiled.m_childEnd;
+                continue;
+            }
+            frame.m_childNodes = std::max(frame.m_childNodes, nodeDepth[child]);
+            frame.m_childDecorators = std::max(frame.m_childDecorators, decoratorDepth[child]);
+            frame.m_next++;
+            continue;
+        }
+
+        if (frame.m_childNodes == UNBOUNDED)
+        {
+            nodeDepth[frame.m_node] = UNBOUNDED;
+            decoratorDepth[frame.m_node] = UNBOUNDED;
+        }
+        else
+        {
+            nodeDepth[frame.m_node] = 1 + frame.m_childNodes;
+            decoratorDepth[frame.m_node] = (compiled.m_decoratorEnd - compiled.m_decoratorBegin) + frame.m_childDecorators;
+        }
+        state[frame.m_node] = DONE;
+        stack.pop_back();
+    }
+}
+
+template <typename C, typename LC, typename DC>
+uint32_t CompiledTree<C,LC,DC>::Compile(Node<C,LC,DC>* node, std::unordered_map<Node<C,LC,DC>*, uint32_t>& indices)
+{
+    auto itr = indices.find(node);
+    if (itr != indices.end())
+    {
+        return itr->second;
+    }
+
+    uint32_t index = uint32_t(m_nodeStorage.size());
+    indices[node] = index;
+    // m_nodeStorage may reallocate while compiling children, so only access it by index
+    m_nodeStorage.emplace_back();
+    m_nodeStorage[index].m_kind = node->m_kind;
+    m_nodeStorage[index].m_decoratorBegin = uint32_t(m_decorators.size());
+    m_decorators.insert(m_decorators.end(), node->m_decorations.begin(), node->m_decorations.end());
+    CallbackRegistry<C,LC,DC>& registry = node->m_gen->Callbacks();
+    for (CallbackSymbol const& symbol : node->m_decorationSymbols)
+    {
+        m_decoratorSymbols.push_back(symbol);
+        m_decoratorSymbols.back().m_perTick = symbol.IsNamed() && registry.IsDecoratorPerTick(symbol.m_name);
+        m_decoratorEvents.push_back(symbol.m_event.empty() ? NO_TREE_EVENT : registry.GetEvent(symbol.m_event));
+    }
+    m_nodeStorage[index].m_decoratorEnd = uint32_t(m_decorators.size());
+    if (!node->m_typedDecorations.empty())
+    {
+        m_typedDecorators.resize(m_decorators.size());
+        std::copy(node->m_typedDecorations.begin(), node->m_typedDecorations.end(), m_typedDecorators.begin() + m_nodeStorage[index].m_decoratorBegin);
+    }
+
+    std::pmr::vector<Node<C,LC,DC>*> const* children = nullptr;
+    switch (node->m_kind)
+    {
+    case NodeKind::LEAF:
+        m_nodeStorage[index].m_callback = uint32_t(m_callbacks.size());
+        m_callbacks.push_back(static_cast<Leaf<C,LC,DC>*>(node)->m_exec);
+        m_callbackSymbols.push_back(static_cast<Leaf<C,LC,DC>*>(node)->m_symbol);
+        m_callbackSymbols.back().m_perTick = m_callbackSymbols.back().IsNamed() && registry.IsLeafPerTick(m_callbackSymbols.back().m_name);
+        if (static_cast<Leaf<C,LC,DC>*>(node)->m_typed.m_memory)
+        {
+            m_typedCallbacks.resize(m_callbacks.size());
+            m_typedCallbacks.back() = static_cast<Leaf<C,LC,DC>*>(node)->m_typed;
+        }
+        if (m_callbackSymbols.back().IsNamed())
+        {
+            if (auto batch = registry.GetBatchLeaf(m_callbackSymbols.back().m_name))
+            {
+                m_batchCallbacks.resize(m_callbacks.size());
+                m_batchCallbacks.back() = std::move(batch);
+            }
+        }
+        else if (auto batch = node->m_gen->m_batchLeaves.find(node); batch != node->m_gen->m_batchLeaves.end())
+        {
+            m_batchCallbacks.resize(m_callbacks.size());
+            m_batchCallbacks.back() = batch->second;
+        }
+        break;
+#ifdef BT_COROUTINES
+    case NodeKind::COROUTINE_LEAF:
+        m_nodeStorage[index].m_callback = uint32_t(m_callbacks.size());
+        m_callbacks.emplace_back();
+        m_callbackSymbols.emplace_back();
+        m_coroutines.resize(m_callbacks.size());
+        m_coroutines.back() = static_cast<Leaf<C,LC,DC>*>(node)->m_coroutine;
+        break;
+#endif
+    case NodeKind::MULTIPLEXER:
+    {
+        Multiplexer<C,LC,DC>* multiplexer = static_cast<Multiplexer<C,LC,DC>*>(node);
+        if (multiplexer->m_callback)
+        {
+            m_nodeStorage[index].m_callback = uint32_t(m_callbacks.size());
+            m_callbacks.push_back(multiplexer->m_callback);
+            m_callbackSymbols.push_back(multiplexer->m_symbol);
+            m_callbackSymbols.back().m_perTick = multiplexer->m_symbol.IsNamed() && registry.IsLeafPerTick(multiplexer->m_symbol.m_name);
+        }
+        children = &multiplexer->m_children;
+        break;
+    }
+    case NodeKind::SEQUENCE:
+    case NodeKind::SELECTOR:
+    {
+        Branch<C,LC,DC>* branch = static_cast<Branch<C,LC,DC>*>(node);
+        m_nodeStorage[index].m_loops = branch->m_loops;
+        m_nodeStorage[index].m_attempts = branch->m_attempts;
+        children = &branch->m_children;
+        break;
+    }
+    default:
+        throw std::runtime_error("Unhandled unknown Node subclass");
+    }
+
+    if (children)
+    {
+        uint32_t begin = uint32_t(m_childStorage.size());
+        m_childStorage.resize(begin + children->size());
+        m_nodeStorage[index].m_childBegin = begin;
+        m_nodeStorage[index].m_childEnd = uint32_t(m_childStorage.size());
+        for (size_t i = 0; i < children->size(); ++i)
+        {
+            uint32_t child = Compile((*children)[i], indices);
+            m_childStorage[begin + i] = child;
+        }
+    }
+    return index;
+}
+
+//
+// Callback Registry
+//
+
+inline bool CallbackSymbol::IsNamed() const
+{
+    return m_name.size() > 0;
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::RegisterLeaf(std::string const& name, LeafCallback<C,LC> callback)
+{
+    m_batchLeaves.erase(name);
+    m_leaves[name] = [=](CallbackArgs const& args) {
+        if (args.size() > 0)
+        {
+            throw std::runtime_error("Leaf callback " + name + " takes no arguments");
+        }
+        return callback;
+    };
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::RegisterBatchLeaf(std::string const& name, BatchLeafCallback<C,LC> callback)
+{
+    auto batch = std::make_shared<BatchLeafCallback<C,LC> const>(std::move(callback));
+    RegisterLeaf(name, BTBatchOfOne<C,LC>(batch));
+    m_batchLeaves[name] = std::move(batch);
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::RegisterDecorator(std::string const& name, DecoratorCallback<C,DC> callback)
+{
+    m_decorators[name] = [=](CallbackArgs const& args) {
+        if (args.size() > 0)
+        {
+            throw std::runtime_error("Decorator callback " + name + " takes no arguments");
+        }
+        return callback;
+    };
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::RegisterLeafFactory(std::string const& name, LeafFactory factory)
+{
+    m_leaves[name] = std::move(factory);
+    m_batchLeaves.erase(name);
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::RegisterDecoratorFactory(std::string const& name, DecoratorFactory factory)
+{
+    m_decorators[name] = std::move(factory);
+}
+
+template <typename C, typename LC, typename DC>
+LeafCallback<C,LC> CallbackRegistry<C,LC,DC>::GetLeaf(std::string const& name, CallbackArgs const& args) const
+{
+    auto itr = m_leaves.find(name);
+    if (itr == m_leaves.end())
+    {
+        throw std::runtime_error("No leaf callback registered as " + name);
+    }
+    return itr->second(args);
+}
+
+template <typename C, typename LC, typename DC>
+DecoratorCallback<C,DC> CallbackRegistry<C,LC,DC>::GetDecorator(std::string const& name, CallbackArgs const& args) const
+{
+    auto itr = m_decorators.find(name);
+    if (itr == m_decorators.end())
+    {
+        throw std::runtime_error("No decorator callback registered as " + name);
+    }
+    return itr->second(args);
+}
+
+template <typename C, typename LC, typename DC>
+bool CallbackRegistry<C,LC,DC>::HasLeaf(std::string const& name) const
+{
+    return m_leaves.find(name) != m_leaves.end();
+}
+
+template <typename C, typename LC, typename DC>
+std::shared_ptr<BatchLeafCallback<C,LC> const> CallbackRegistry<C,LC,DC>::GetBatchLeaf(std::string const& name) const
+{
+    auto itr = m_batchLeaves.find(name);
+    return itr == m_batchLeaves.end() ? nullptr : itr->second;
+}
+
+template <typename C, typename LC, typename DC>
+bool CallbackRegistry<C,LC,DC>::HasDecorator(std::string const& name) const
+{
+    return m_decorators.find(name) != m_decorators.end();
+}
+
+template <typename C, typename LC, typename DC>
+TreeEventId CallbackRegistry<C,LC,DC>::RegisterEvent(std::string const& name)
+{
+    return m_events.emplace(name, TreeEventId(m_events.size())).first->second;
+}
+
+template <typename C, typename LC, typename DC>
+TreeEventId CallbackRegistry<C,LC,DC>::GetEvent(std::string const& name) const
+{
+    auto itr = m_events.find(name);
+    if (itr == m_events.end())
+    {
+        throw std::runtime_error("No event registered as " + name);
+    }
+    return itr->second;
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::MarkLeafPerTick(std::string const& name)
+{
+    m_perTickLeaves.insert(name);
+}
+
+template <typename C, typename LC, typename DC>
+void CallbackRegistry<C,LC,DC>::MarkDecoratorPerTick(std::string const& name)
+{
+    m_perTickDecorators.insert(name);
+}
+
+template <typename C, typename LC, typename DC>
+bool CallbackRegistry<C,LC,DC>::IsLeafPerTick(std::string const& name) const
+{
+    return m_perTickLeaves.find(name) != m_perTickLeaves.end();
+}
+
+template <typename C, typename LC, typename DC>
+bool CallbackRegistry<C,LC,DC>::IsDecoratorPerTick(std::string const& name) const
+{
+    return m_perTickDecorators.find(name) != m_perTickDecorators.end();
+}
+
+//
+// Decorable Methods
+//
+
+template <typename C, typename LC, typename DC, typename T>
+T* DecorableNode<C,LC,DC, T>::Decorate(DecoratorCallback<C,DC> predicate)
+{
+    this->OnModify();
+    this->m_decorations.push_back(std::move(predicate));
+    this->m_decorationSymbols.emplace_back();
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+T* DecorableNode<C,LC,DC,T>::Decorate(std::vector<DecoratorCallback<C,DC>> predicates)
+{
+    this->OnModify();
+    this->m_decorations.insert(this->m_decorations.end(), std::make_move_iterator(predicates.begin()), std::make_move_iterator(predicates.end()));
+    this->m_decorationSymbols.resize(this->m_decorations.size());
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+T* DecorableNode<C,LC,DC,T>::Decorate(std::string const& name, CallbackArgs const& args)
+{
+    this->OnModify();
+    this->m_decorations.push_back(this->m_gen->Callbacks().GetDecorator(name, args));
+    this->m_decorationSymbols.push_back({ name, args });
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+T* DecorableNode<C,LC,DC,T>::DecorateOn(std::string const& event, DecoratorCallback<C,DC> predicate)
+{
+    this->OnModify();
+    this->m_gen->Callbacks().RegisterEvent(event);
+    this->m_decorations.push_back(std::move(predicate));
+    this->m_decorationSymbols.push_back({ {}, {}, event });
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+T* DecorableNode<C,LC,DC,T>::DecorateOn(std::string const& event, std::string const& name, CallbackArgs const& args)
+{
+    this->OnModify();
+    this->m_gen->Callbacks().RegisterEvent(event);
+    this->m_decorations.push_back(this->m_gen->Callbacks().GetDecorator(name, args));
+    this->m_decorationSymbols.push_back({ name, args, event });
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+template <typename M>
+T* DecorableNode<C,LC,DC,T>::DecorateTyped(std::function<int(C&,M&)> predicate)
+{
+    this->OnModify();
+    this->m_decorations.emplace_back();
+    this->m_decorationSymbols.emplace_back();
+    this->m_typedDecorations.resize(this->m_decorations.size());
+    this->m_typedDecorations.back() = TypedCallback<C>::template Of<M>(std::move(predicate));
+    return dynamic_cast<T*>(this);
+}
+
+//
+// Branch Methods
+//
+
+template <typename C, typename LC, typename DC, typename T>
+T* BranchNode<C,LC,DC,T>::AddSequence(Builder<Branch<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Branch<C,LC,DC>* b = this->m_gen->CreateSequence();
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddSelector(Builder<Branch<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Branch<C,LC,DC>* b = this->m_gen->CreateSelector();
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddLeaf(LeafCallback<C,LC> exec, Builder<Leaf<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(std::move(exec));
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+T* BranchNode<C,LC,DC,T>::AddLeaf(LeafCallback<C,LC> exec)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(std::move(exec));
+    m_children.push_back(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+template <typename M>
+T* BranchNode<C,LC,DC,T>::AddTypedLeaf(std::function<int(C&,M&)> exec, Builder<Leaf<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateTypedLeaf(std::move(exec));
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+template <typename M>
+T* BranchNode<C,LC,DC,T>::AddTypedLeaf(std::function<int(C&,M&)> exec)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateTypedLeaf(std::move(exec));
+    m_children.push_back(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddBatchLeaf(BatchLeafCallback<C,LC> exec, Builder<Leaf<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateBatchLeaf(std::move(exec));
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddBatchLeaf(BatchLeafCallback<C,LC> exec)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateBatchLeaf(std::move(exec));
+    m_children.push_back(b);
+    return dynamic_cast<T*>(this);
+}
+
+#ifdef BT_COROUTINES
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddCoroutineLeaf(CoroutineLeafCallback<C> coroutine, Builder<Leaf<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateCoroutineLeaf(std::move(coroutine));
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC, typename T>
+T* BranchNode<C,LC,DC,T>::AddCoroutineLeaf(CoroutineLeafCallback<C> coroutine)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateCoroutineLeaf(std::move(coroutine));
+    m_children.push_back(b);
+    return dynamic_cast<T*>(this);
+}
+#endif
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddLeaf(std::string const& name, Builder<Leaf<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(name);
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddLeaf(std::string const& name, CallbackArgs const& args, Builder<Leaf<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(name, args);
+    m_children.push_back(b);
+    builder(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddLeaf(std::string const& name, CallbackArgs const& args)
+{
+    this->OnModify();
+    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(name, args);
+    m_children.push_back(b);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddNode(Node<C,LC,DC>* node)
+{
+    this->OnModify();
+    m_children.push_back(node);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddMultiplexer(LeafCallback<C,LC> callback, Builder<Multiplexer<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Multiplexer<C,LC,DC>* multiplexer = this->m_gen->CreateMultiplexer(std::move(callback));
+    this->m_children.emplace_back(multiplexer);
+    builder(multiplexer);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddMultiplexer(std::string const& name, Builder<Multiplexer<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Multiplexer<C,LC,DC>* multiplexer = this->m_gen->CreateMultiplexer(name);
+    this->m_children.emplace_back(multiplexer);
+    builder(multiplexer);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddMultiplexer(std::string const& name, CallbackArgs const& args, Builder<Multiplexer<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Multiplexer<C,LC,DC>* multiplexer = this->m_gen->CreateMultiplexer(name, args);
+    this->m_children.emplace_back(multiplexer);
+    builder(multiplexer);
+    return dynamic_cast<T*>(this);
+}
+
+template <typename C, typename LC, typename DC,typename T>
+T* BranchNode<C,LC,DC,T>::AddMultiplexer(Builder<Multiplexer<C,LC,DC>> builder)
+{
+    this->OnModify();
+    Multiplexer<C,LC,DC>* multiplexer = this->m_gen->CreateMultiplexer();
+    this->m_children.emplace_back(multiplexer);
+    builder(multiplexer);
+    return dynamic_cast<T*>(this);
+}
+
 //
-// Creator Methods
+// Profiling
 //
-template <typename C, typename LC, typename DC>
-void BehaviorTreeContext<C,LC,DC>::DestroyAllNodes()
-{
-    m_leaves.clear();
-    m_multiplexers.clear();
-    m_branches.clear();
-}
 
-template <typename C, typename LC, typename DC>
-Branch<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateSequence()
+#ifdef BT_PROFILING
+inline uint64_t BTProfileNow()
 {
-    return m_branches.emplace_back(std::make_unique<Branch<C,LC,DC>>(this, BranchType::SEQUENCE)).get();
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
 }
 
-template <typename C, typename LC, typename DC>
-Branch<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateSelector()
+inline void BTAtomicMax(std::atomic<uint64_t>& target, uint64_t value)
 {
-    return m_branches.emplace_back(std::make_unique<Branch<C,LC,DC>>(this, BranchType::SELECTOR)).get();
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
 }
 
 template <typename C, typename LC, typename DC>
-Multiplexer<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateMultiplexer(LeafCallback<C,LC> callback)
+void CompiledTree<C,LC,DC>::RecordCall(uint32_t node, int result, uint64_t nanos) const
 {
-    return m_multiplexers.emplace_back(std::make_unique<Multiplexer<C,LC,DC>>(this, callback)).get();
+    NodeCounters& counters = m_counters[node];
+    counters.m_calls.fetch_add(1, std::memory_order_relaxed);
+    switch (result)
+    {
+    case Result::SUCCESS:
+        counters.m_successes.fetch_add(1, std::memory_order_relaxed);
+        break;
+    case Result::FAILURE:
+        counters.m_failures.fetch_add(1, std::memory_order_relaxed);
+        break;
+    default:
+        counters.m_delays.fetch_add(1, std::memory_order_relaxed);
+        break;
+    }
+    counters.m_callNanos.fetch_add(nanos, std::memory_order_relaxed);
+    BTAtomicMax(counters.m_maxCallNanos, nanos);
 }
 
 template <typename C, typename LC, typename DC>
-Multiplexer<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateMultiplexer()
+void CompiledTree<C,LC,DC>::RecordDecorator(uint32_t node, int result, uint64_t nanos) const
 {
-    return m_multiplexers.emplace_back(std::make_unique<Multiplexer<C,LC,DC>>(this)).get();
+    NodeCounters& counters = m_counters[node];
+    counters.m_decoratorCalls.fetch_add(1, std::memory_order_relaxed);
+    if (result == Result::FAILURE)
+    {
+        counters.m_decoratorFailures.fetch_add(1, std::memory_order_relaxed);
+    }
+    counters.m_decoratorNanos.fetch_add(nanos, std::memory_order_relaxed);
+    BTAtomicMax(counters.m_maxDecoratorNanos, nanos);
 }
 
 template <typename C, typename LC, typename DC>
-Leaf<C,LC,DC>* BehaviorTreeContext<C,LC,DC>::CreateLeaf(LeafCallback<C,LC> exec)
+void CompiledTree<C,LC,DC>::Profile(ProfileSnapshot& snapshot, void const* root) const
 {
-    return m_leaves.emplace_back(std::make_unique<Leaf<C,LC,DC>>(this, exec)).get();
+    uint32_t treeIndex = uint32_t(snapshot.m_trees.size());
+    snapshot.m_trees.push_back({
+        root,
+        m_updates.load(std::memory_order_relaxed),
+        m_rebuilds.load(std::memory_order_relaxed),
+        m_traversals.load(std::memory_order_relaxed)
+    });
+    for (uint32_t i = 0; i < m_nodeCount; ++i)
+    {
+        NodeCounters const& counters = m_counters[i];
+        NodeProfile profile;
+        profile.m_tree = treeIndex;
+        profile.m_node = i;
+        profile.m_kind = m_nodes[i].m_kind;
+        if (m_nodes[i].m_callback != CompiledNode::NO_CALLBACK)
+        {
+            profile.m_name = m_callbackSymbols[m_nodes[i].m_callback].m_name;
+        }
+        profile.m_visits = counters.m_visits.load(std::memory_order_relaxed);
+        profile.m_calls = counters.m_calls.load(std::memory_order_relaxed);
+        profile.m_successes = counters.m_successes.load(std::memory_order_relaxed);
+        profile.m_failures = counters.m_failures.load(std::memory_order_relaxed);
+        profile.m_delays = counters.m_delays.load(std::memory_order_relaxed);
+        profile.m_callNanos = counters.m_callNanos.load(std::memory_order_relaxed);
+        profile.m_maxCallNanos = counters.m_maxCallNanos.load(std::memory_order_relaxed);
+        profile.m_decoratorCalls = counters.m_decoratorCalls.load(std::memory_order_relaxed);
+        profile.m_decoratorFailures = counters.m_decoratorFailures.load(std::memory_order_relaxed);
+        profile.m_decoratorNanos = counters.m_decoratorNanos.load(std::memory_order_relaxed);
+        profile.m_maxDecoratorNanos = counters.m_maxDecoratorNanos.load(std::memory_order_relaxed);
+        snapshot.m_nodes.push_back(std::move(profile));
+    }
 }
 
 template <typename C, typename LC, typename DC>
-void BehaviorTreeContext<C,LC,DC>::VerifyNode(Node<C,LC,DC>* node)
+void CompiledTree<C,LC,DC>::ResetProfile() const
 {
+    // zeroed in place, executors may still be updating them
+    for (uint32_t i = 0; i < m_nodeCount; ++i)
+    {
+        NodeCounters& c = m_counters[i];
+        for (std::atomic<uint64_t>* counter : { &c.m_visits, &c.m_calls, &c.m_successes, &c.m_failures, &c.m_delays, &c.m_callNanos, &c.m_maxCallNanos, &c.m_decoratorCalls, &c.m_decoratorFailures, &c.m_decoratorNanos, &c.m_maxDecoratorNanos })
+        {
+            counter->store(0, std::memory_order_relaxed);
+        }
+    }
+    m_updates = 0;
+    m_rebuilds = 0;
+    m_traversals = 0;
 }
 
-//
-// Decorable Methods
-//
-
-template <typename C, typename LC, typename DC, typename T>
-T* DecorableNode<C,LC,DC, T>::Decorate(DecoratorCallback<C,DC> predicate)
+template <typename C, typename LC, typename DC>
+ProfileSnapshot BehaviorTreeContext<C,LC,DC>::Profile()
 {
-    this->m_decorations.push_back(predicate);
-    return dynamic_cast<T*>(this);
+    std::lock_guard<std::mutex> lock(m_compileMutex);
+    ProfileSnapshot snapshot;
+    for (auto const& [root, tree] : m_compiled)
+    {
+        tree->Profile(snapshot, root);
+    }
+    return snapshot;
 }
 
-template <typename C, typename LC, typename DC, typename T>
-T* DecorableNode<C,LC,DC,T>::Decorate(std::vector<DecoratorCallback<C,DC>> predicates)
+template <typename C, typename LC, typename DC>
+void BehaviorTreeContext<C,LC,DC>::ResetProfile()
 {
-    this->m_decorations.insert(this->m_decorations.end(), predicates.begin(), predicates.end());
-    return dynamic_cast<T*>(this);
+    std::lock_guard<std::mutex> lock(m_compileMutex);
+    for (auto const& [root, tree] : m_compiled)
+    {
+        tree->ResetProfile();
+    }
 }
+#endif
 
 //
-// Branch Methods
+// Tracing
 //
 
-template <typename C, typename LC, typename DC, typename T>
-T* BranchNode<C,LC,DC,T>::AddSequence(Builder<Branch<C,LC,DC>> builder)
-{
-    Branch<C,LC,DC>* b = this->m_gen->CreateSequence();
-    m_children.push_back(b);
-    builder(b);
-    return dynamic_cast<T*>(this);
-}
-
-template <typename C, typename LC, typename DC,typename T>
-T* BranchNode<C,LC,DC,T>::AddSelector(Builder<Branch<C,LC,DC>> builder)
+inline TraceBuffer::TraceBuffer(size_t capacity)
 {
-    Branch<C,LC,DC>* b = this->m_gen->CreateSelector();
-    m_children.push_back(b);
-    builder(b);
-    return dynamic_cast<T*>(this);
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    m_events.reset(new Slot[size]);
+    m_mask = size - 1;
 }
 
-template <typename C, typename LC, typename DC,typename T>
-T* BranchNode<C,LC,DC,T>::AddLeaf(LeafCallback<C,LC> exec, Builder<Leaf<C,LC,DC>> builder)
+inline void TraceBuffer::Record(uint64_t time, TraceEventType type, uint32_t index, int32_t result)
 {
-    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(exec);
-    m_children.push_back(b);
-    builder(b);
-    return dynamic_cast<T*>(this);
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    // readers that see any part of the new event also see the claim
+    m_claimed.store(head + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot& slot = m_events[head & m_mask];
+    slot.m_time.store(time, std::memory_order_relaxed);
+    slot.m_type.store(type, std::memory_order_relaxed);
+    slot.m_index.store(index, std::memory_order_relaxed);
+    slot.m_result.store(result, std::memory_order_relaxed);
+    m_head.store(head + 1, std::memory_order_release);
 }
 
-template <typename C, typename LC, typename DC, typename T>
-T* BranchNode<C,LC,DC,T>::AddLeaf(LeafCallback<C,LC> exec)
+inline std::vector<TraceEvent> TraceBuffer::Events() const
 {
-    Leaf<C,LC,DC>* b = this->m_gen->CreateLeaf(exec);
-    m_children.push_back(b);
-    return dynamic_cast<T*>(this);
+    uint64_t end = m_head.load(std::memory_order_acquire);
+    uint64_t begin = end > m_mask ? end - m_mask - 1 : 0;
+    std::vector<TraceEvent> events;
+    events.reserve(size_t(end - begin));
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        Slot const& slot = m_events[i & m_mask];
+        events.push_back({
+            slot.m_time.load(std::memory_order_relaxed),
+            slot.m_type.load(std::memory_order_relaxed),
+            slot.m_index.load(std::memory_order_relaxed),
+            slot.m_result.load(std::memory_order_relaxed)
+        });
+    }
+    // drop whatever the executor overwrote while we were copying,
+    // including the slot it may be writing right now. The fence keeps the
+    // copies above from moving past the load.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t claimed = m_claimed.load(std::memory_order_relaxed);
+    uint64_t overwritten = claimed > m_mask + begin ? claimed - m_mask - begin : 0;
+    events.erase(events.begin(), events.begin() + size_t(std::min<uint64_t>(overwritten, events.size())));
+    return events;
 }
 
-template <typename C, typename LC, typename DC,typename T>
-T* BranchNode<C,LC,DC,T>::AddNode(Node<C,LC,DC>* node)
+inline uint64_t TraceBuffer::Recorded() const
 {
-    m_children.push_back(node);
-    return dynamic_cast<T*>(this);
+    return m_head.load(std::memory_order_acquire);
 }
 
-template <typename C, typename LC, typename DC,typename T>
-T* BranchNode<C,LC,DC,T>::AddMultiplexer(LeafCallback<C,LC> callback, Builder<Multiplexer<C,LC,DC>> builder)
+inline size_t TraceBuffer::Capacity() const
 {
-    Multiplexer<C,LC,DC>* multiplexer = this->m_gen->CreateMultiplexer(callback);
-    this->m_children.emplace_back(multiplexer);
-    builder(multiplexer);
-    return dynamic_cast<T*>(this);
+    return m_mask + 1;
 }
 
-template <typename C, typename LC, typename DC,typename T>
-T* BranchNode<C,LC,DC,T>::AddMultiplexer(Builder<Multiplexer<C,LC,DC>> builder)
+inline void TraceBuffer::Clear()
 {
-    Multiplexer<C,LC,DC>* multiplexer = this->m_gen->CreateMultiplexer();
-    this->m_children.emplace_back(multiplexer);
-    builder(multiplexer);
-    return dynamic_cast<T*>(this);
+    m_head.store(0, std::memory_order_release);
+    m_claimed.store(0, std::memory_order_release);
 }
 
 // Executor
@@ -227,6 +2034,11 @@ inline bool TreeTimer::HasPassed(uint64_t now)
     return m_start + m_delay <= now;
 }
 
+inline uint64_t TreeTimer::Deadline() const
+{
+    return m_delay > UINT64_MAX - m_start ? UINT64_MAX : m_start + m_delay;
+}
+
 inline void TreeTimer::Set(uint64_t now, uint64_t delay)
 {
     m_start = now;
@@ -246,9 +2058,207 @@ inline void TreeTimer::Clear()
 }
 
 
+inline bool UpdateBudget::Spend()
+{
+    if (m_transitions == 0)
+    {
+        return false;
+    }
+    m_transitions--;
+    if (m_deadline != Clock::time_point::max() && (m_spent++ & 31) == 0 && Clock::now() >= m_deadline)
+    {
+        m_transitions = 0;
+        return false;
+    }
+    return true;
+}
+
+inline bool UpdateBudget::Exhausted() const
+{
+    return m_transitions == 0 || (m_deadline != Clock::time_point::max() && Clock::now() >= m_deadline);
+}
+
+inline void TreeMemo::Begin(uint32_t slots)
+{
+    if (m_epochs.size() < slots)
+    {
+        m_epochs.resize(slots, 0);
+        m_results.resize(slots, 0);
+    }
+    m_epoch++;
+}
+
+template <typename C, typename M>
+int TreeMemo::Call(uint32_t slot, std::function<int(C&,M&)> const& callback, C& ctx, M& memory)
+{
+    if (slot == NO_MEMO)
+    {
+        return callback(ctx, memory);
+    }
+    if (m_epochs[slot] != m_epoch)
+    {
+        m_results[slot] = callback(ctx, memory);
+        m_epochs[slot] = m_epoch;
+    }
+    return m_results[slot];
+}
+
+template <typename C, typename LC, typename DC>
+void LeafBatch<C,LC,DC>::Queue(BatchLeafCallback<C,LC> const* callback, TreeExecutor<C,LC,DC>* executor, C& ctx, LC& memory)
+{
+    // there are few distinct batched leaves, and searching them does not
+    // allocate once the groups have been created
+    size_t index = 0;
+    while (index < m_activeGroups && m_groups[index].m_callback != callback)
+    {
+        index++;
+    }
+    if (index == m_activeGroups)
+    {
+        if (m_activeGroups == m_groups.size())
+        {
+            m_groups.emplace_back();
+        }
+        m_groups[m_activeGroups++].m_callback = callback;
+    }
+    Group& group = m_groups[index];
+    group.m_contexts.push_back(&ctx);
+    group.m_memories.push_back(&memory);
+    group.m_executors.push_back(executor);
+    m_size++;
+}
+
+template <typename C, typename LC, typename DC>
+void LeafBatch<C,LC,DC>::Run()
+{
+    try
+    {
+        for (size_t i = 0; i < m_activeGroups; ++i)
+        {
+            Group& group = m_groups[i];
+            group.m_results.assign(group.m_executors.size(), Result::FAILURE);
+            (*group.m_callback)(group.m_executors.size(), group.m_contexts.data(), group.m_memories.data(), group.m_results.data());
+            for (size_t j = 0; j < group.m_executors.size(); ++j)
+            {
+                group.m_executors[j]->m_batchResult = group.m_results[j];
+                group.m_executors[j]->m_batchReady = true;
+            }
+        }
+    }
+    catch (...)
+    {
+        Clear();
+        throw;
+    }
+    Clear();
+}
+
+template <typename C, typename LC, typename DC>
+size_t LeafBatch<C,LC,DC>::Size() const
+{
+    return m_size;
+}
+
+template <typename C, typename LC, typename DC>
+void LeafBatch<C,LC,DC>::Clear()
+{
+    for (size_t i = 0; i < m_activeGroups; ++i)
+    {
+        m_groups[i].m_contexts.clear();
+        m_groups[i].m_memories.clear();
+        m_groups[i].m_executors.clear();
+    }
+    m_activeGroups = 0;
+    m_size = 0;
+}
+
 template <typename C, typename LC, typename DC>
 void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
 {
+    Step(ctx, now, nullptr, nullptr, nullptr);
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now, UpdateBudget& budget)
+{
+    return Step(ctx, now, &budget, nullptr, nullptr);
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now, UpdateBudget& budget, LeafBatch<C,LC,DC>& batch)
+{
+    return Step(ctx, now, &budget, nullptr, &batch);
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::IsSuspended() const
+{
+    return m_suspension != Suspension::NONE;
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::IsWaitingOnBatch() const
+{
+    return m_batchWait;
+}
+
+#ifdef BT_COROUTINES
+template <typename C, typename LC, typename DC>
+TreeFramePool const& TreeExecutor<C,LC,DC>::FramePool() const
+{
+    return m_framePool;
+}
+#endif
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::UpdateSubtrees(C& ctx, uint64_t now, UpdateBudget* budget, TreeMemo* memo, LeafBatch<C,LC,DC>* batch, size_t first)
+{
+    for (size_t i = first; i < m_activeSubtrees; ++i)
+    {
+        if (m_subtrees[i].Step(ctx, now, budget, memo, batch))
+        {
+            m_suspension = Suspension::SUBTREES;
+            m_resumeAt = uint32_t(i);
+            m_batchWait = m_subtrees[i].m_batchWait;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeExecutor<C,LC,DC>::Step(C& ctx, uint64_t now, UpdateBudget* budget, TreeMemo* memo, LeafBatch<C,LC,DC>* batch)
+{
+    if (m_tree == nullptr)
+    {
+        m_treeRef = m_ctx->Compile(m_rootNode);
+        m_tree = m_treeRef.get();
+    }
+    CompiledTree<C,LC,DC> const& tree = *m_tree;
+
+    // resuming a suspended update finishes the tick it belongs to, and
+    // updates waiting on a timer do no work so do not start a new one
+    if (m_suspension == Suspension::NONE && m_tickInterval != 0)
+    {
+        if (now < NextTick() || now < NextDeadline())
+        {
+            return false;
+        }
+        m_lastTick = now;
+        m_ticked = true;
+    }
+    // continuing an update that waited on a batched leaf
+    bool batchResume = m_batchWait;
+    m_batchWait = false;
+    if (memo == nullptr)
+    {
+        memo = &m_memo;
+        if (!batchResume)
+        {
+            memo->Begin(tree.m_memoCount);
+        }
+    }
+
     // ====================================================================
     // Goto Call Setup
     // ====================================================================
@@ -271,58 +2281,108 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
 #define __BT_TREE_GOTO_ADD_CHILD(aChild)\
     child = aChild;\
     goto add_child;
-    Node<C,LC,DC>* child;
+    uint32_t child;
 
 #define __BT_TREE_GOTO_EXECUTE()\
     goto execute;
+    bool batchReady = false;
+
+#ifdef BT_PROFILING
+#define __BT_TREE_PROFILE(statement) statement
+#else
+#define __BT_TREE_PROFILE(statement)
+#endif
+    __BT_TREE_PROFILE(tree.m_updates.fetch_add(1, std::memory_order_relaxed);)
+
+#define __BT_TREE_TRACE(aType,aIndex,aResult)\
+    if (m_trace) m_trace->Record(now, TraceEventType::aType, uint32_t(aIndex), int32_t(aResult));
+    if (!m_subtree && !batchResume)
+    {
+        __BT_TREE_TRACE(UPDATE, m_nodeStack.size(), 0)
+    }
 
     // ====================================================================
     // Start
     // ====================================================================
     {
+        Suspension suspension = m_suspension;
+        m_suspension = Suspension::NONE;
         if (m_nodeStack.size() == 0)
         {
+            // a delay left over from an interrupted root must not hold up the restart
+            m_endTimer.Clear();
             __BT_TREE_GOTO_ADD_CHILD(m_root)
         }
-        for (int i = 0; i < m_decoratorStack.size(); ++i)
+        for (int i = 0; !batchResume && i < m_decoratorStack.size(); ++i)
         {
             DecoratorStackEntry<DC>& decoratorEntry = m_decoratorStack[i];
-            if (!decoratorEntry.m_timer.HasPassed(now))
+            bool notified = decoratorEntry.m_notified;
+            if (!notified && !decoratorEntry.m_timer.HasPassed(now))
             {
                 continue;
             }
-            DecoratorCallback<C,DC> decorator = m_nodeStack[decoratorEntry.m_nodeStackIndex].m_node->m_decorations[decoratorEntry.m_decoratorIndex];
-            int result = decorator(ctx,decoratorEntry.m_memory);
+            decoratorEntry.m_notified = false;
+            uint32_t decoratedIndex = m_nodeStack[decoratorEntry.m_nodeStackIndex].m_node;
+            CompiledNode const& decorated = tree.m_nodes[decoratedIndex];
+            if (notified)
+            {
+                __BT_TREE_TRACE(NOTIFY, tree.m_decoratorEvents[decorated.m_decoratorBegin + decoratorEntry.m_decoratorIndex], 0)
+            }
+            __BT_TREE_PROFILE(uint64_t profileStart = BTProfileNow();)
+            uint32_t decorator = decorated.m_decoratorBegin + decoratorEntry.m_decoratorIndex;
+            int result = decoratorEntry.m_slabOffset != TreeSlab::NONE
+                ? tree.m_typedDecorators[decorator].m_callback(ctx, m_slab.At(decoratorEntry.m_slabOffset))
+                : memo->Call(tree.m_decoratorMemos[decorator], tree.m_decorators[decorator], ctx, decoratorEntry.m_memory);
+            __BT_TREE_PROFILE(tree.RecordDecorator(decoratedIndex, result, BTProfileNow() - profileStart);)
+            __BT_TREE_TRACE(DECORATOR, decorator, result)
             switch (result)
             {
             case Result::SUCCESS:
                 decoratorEntry.m_timer.Disable();
                 break;
             case Result::FAILURE:
-                __BT_TREE_GOTO_REBUILD(decoratorEntry.m_nodeStackIndex, Result::FAILURE);
+                // the decorated node fails, so its parent is the one to continue
+                __BT_TREE_GOTO_REBUILD(decoratorEntry.m_nodeStackIndex - 1, Result::FAILURE);
             default:
                 decoratorEntry.m_timer.Set(now, result);
                 break;
             }
         }
-        __BT_TREE_GOTO_EXECUTE()
+        switch (suspension)
+        {
+        case Suspension::ADD_CHILD:
+            __BT_TREE_GOTO_ADD_CHILD(m_resumeAt)
+        case Suspension::SUBTREES:
+            return UpdateSubtrees(ctx, now, budget, memo, batch, m_resumeAt);
+        case Suspension::BATCH:
+            batchReady = m_batchReady;
+            m_batchReady = false;
+            __BT_TREE_GOTO_EXECUTE()
+        default:
+            __BT_TREE_GOTO_EXECUTE()
+        }
     }
 
     // ====================================================================
     __BT_TREE_LABEL(rebuild)
     // ====================================================================
     {
+        __BT_TREE_PROFILE(tree.m_rebuilds.fetch_add(1, std::memory_order_relaxed);)
+        __BT_TREE_TRACE(REBUILD, node, reason)
         if (node < 0)
         {
+            LeaveSubtrees();
             m_nodeStack.clear();
             m_decoratorStack.clear();
-            return;
+            m_slab.PopTo(0);
+            return false;
         }
         else
         {
             m_nodeStack.resize(node + 1);
             int decoStackSize = m_nodeStack[m_nodeStack.size()-1].m_decoStackSize;
             m_decoratorStack.resize(decoStackSize);
+            m_slab.PopTo(m_nodeStack[m_nodeStack.size()-1].m_slabMark);
             __BT_TREE_GOTO_TRAVERSE(ResultToTraversal(reason));
         }
     }
@@ -334,20 +2394,22 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
     //  - top of node stack is a branch
     // ====================================================================
     {
-        m_subtrees.clear();
+        __BT_TREE_PROFILE(tree.m_traversals.fetch_add(1, std::memory_order_relaxed);)
+        LeaveSubtrees();
         m_endTimer.Clear();
         NodeStackEntry<C,LC,DC>& entry = m_nodeStack[m_nodeStack.size() - 1];
-        Branch<C,LC,DC>* branch = static_cast<Branch<C,LC,DC>*>(entry.m_node);
+        __BT_TREE_TRACE(TRAVERSE, entry.m_node, mode)
+        CompiledNode const& branch = tree.m_nodes[entry.m_node];
         switch (mode)
         {
         case TraversalMode::SUCCESS:
-            switch (branch->m_type)
+            switch (branch.m_kind)
             {
-            case BranchType::SELECTOR:
+            case NodeKind::SELECTOR:
                 entry.m_loop++;
                 entry.m_ctr = 0;
                 break;
-            case BranchType::SEQUENCE:
+            case NodeKind::SEQUENCE:
                 entry.m_ctr++;
                 break;
             default:
@@ -356,12 +2418,12 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
             }
             break;
         case TraversalMode::FAILURE:
-            switch (branch->m_type)
+            switch (branch.m_kind)
             {
-            case BranchType::SELECTOR:
+            case NodeKind::SELECTOR:
                 entry.m_ctr++;
                 break;
-            case BranchType::SEQUENCE:
+            case NodeKind::SEQUENCE:
                 entry.m_retry++;
                 entry.m_ctr = 0;
                 break;
@@ -372,15 +2434,15 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
             break;
         }
 
-        if (entry.m_ctr >= branch->m_children.size())
+        if (entry.m_ctr >= branch.m_childEnd - branch.m_childBegin)
         {
-            switch (branch->m_type)
+            switch (branch.m_kind)
             {
-            case BranchType::SELECTOR:
+            case NodeKind::SELECTOR:
                 entry.m_retry++;
                 entry.m_ctr = 0;
                 break;
-            case BranchType::SEQUENCE:
+            case NodeKind::SEQUENCE:
                 entry.m_loop++;
                 entry.m_ctr = 0;
                 break;
@@ -390,16 +2452,16 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
             }
         }
 
-        if (entry.m_retry >= branch->m_attempts)
+        if (entry.m_retry >= branch.m_attempts)
         {
             __BT_TREE_GOTO_REBUILD(int(m_nodeStack.size() - 2), Result::FAILURE);
         }
-        else if (entry.m_loop >= branch->m_loops)
+        else if (entry.m_loop >= branch.m_loops)
         {
             __BT_TREE_GOTO_REBUILD(int(m_nodeStack.size() - 2), Result::SUCCESS);
         }
         else {
-            __BT_TREE_GOTO_ADD_CHILD(branch->m_children[entry.m_ctr]);
+            __BT_TREE_GOTO_ADD_CHILD(tree.m_children[branch.m_childBegin + entry.m_ctr]);
         }
     }
 
@@ -407,21 +2469,58 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
     __BT_TREE_LABEL(add_child)
     // ====================================================================
     {
-        for (int i = 0; i < child->m_decorations.size(); ++i)
+        if (budget && !budget->Spend())
+        {
+            __BT_TREE_TRACE(SUSPEND, child, 0)
+            m_suspension = Suspension::ADD_CHILD;
+            m_resumeAt = child;
+            return true;
+        }
+        CompiledNode const& childNode = tree.m_nodes[child];
+        __BT_TREE_PROFILE(tree.m_counters[child].m_visits.fetch_add(1, std::memory_order_relaxed);)
+        __BT_TREE_TRACE(ADD_CHILD, child, 0)
+        int oldSize = int(m_decoratorStack.size());
+        size_t oldMark = m_slab.Mark();
+        for (uint32_t i = childNode.m_decoratorBegin; i < childNode.m_decoratorEnd; ++i)
         {
             DC dc;
-            DecoratorCallback<C,DC> decorator = child->m_decorations[i];
-            int oldSize = int(m_decoratorStack.size());
-            int value = decorator(ctx,dc);
+            uint32_t offset = TreeSlab::NONE;
+            __BT_TREE_PROFILE(uint64_t profileStart = BTProfileNow();)
+            int value;
+            if (TreeMemoryType const* memory = tree.m_typedDecorators[i].m_memory)
+            {
+                offset = m_slab.Push(*memory);
+                value = tree.m_typedDecorators[i].m_callback(ctx, m_slab.At(offset));
+            }
+            else
+            {
+                value = memo->Call(tree.m_decoratorMemos[i], tree.m_decorators[i], ctx, dc);
+            }
+            __BT_TREE_PROFILE(tree.RecordDecorator(child, value, BTProfileNow() - profileStart);)
+            __BT_TREE_TRACE(DECORATOR, i, value)
             switch (value)
             {
             case Result::SUCCESS:
+                // kept around, but only to be re-evaluated on its event
+                if (tree.m_decoratorEvents[i] != NO_TREE_EVENT)
+                {
+                    m_decoratorStack.push_back({ std::move(dc), int(m_nodeStack.size()), int(i - childNode.m_decoratorBegin), {} });
+                    m_decoratorStack.back().m_timer.Disable();
+                    m_decoratorStack.back().m_slabOffset = offset;
+                }
+                else if (offset != TreeSlab::NONE)
+                {
+                    m_slab.PopTo(m_slab.Mark() - 1);
+                }
                 break;
             case Result::FAILURE:
+                // drop delayed decorators already pushed for this child
+                m_decoratorStack.resize(oldSize);
+                m_slab.PopTo(oldMark);
                 if (m_nodeStack.size() == 0)
                 {
                     m_decoratorStack.clear();
-                    return;
+                    return false;
                 }
                 else
                 {
@@ -429,25 +2528,27 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
                 }
                 break;
             default:
-                m_decoratorStack.push_back({ std::move(dc), int(m_nodeStack.size()), i, {now,uint64_t(value)} });
+                m_decoratorStack.push_back({ std::move(dc), int(m_nodeStack.size()), int(i - childNode.m_decoratorBegin), {now,uint64_t(value)} });
+                m_decoratorStack.back().m_slabOffset = offset;
                 break;
             }
         }
         m_nodeStack.push_back({ child,LC(),int(m_decoratorStack.size()) });
-
-        if (Branch<C,LC,DC>* branch = dynamic_cast<Branch<C,LC,DC>*>(child))
+        if (childNode.m_kind == NodeKind::LEAF && tree.m_typedCallbacks[childNode.m_callback].m_memory)
         {
-            __BT_TREE_GOTO_TRAVERSE(TraversalMode::TRAVERSAL)
+            m_nodeStack.back().m_slabOffset = m_slab.Push(*tree.m_typedCallbacks[childNode.m_callback].m_memory);
         }
-        else
+        m_nodeStack.back().m_slabMark = uint32_t(m_slab.Mark());
+
+        switch (childNode.m_kind)
         {
-            if (Multiplexer<C,LC,DC>* multiplexer = dynamic_cast<Multiplexer<C,LC,DC>*>(child))
-            {
-                for (Node<C,LC,DC>* child : multiplexer->m_children)
-                {
-                    m_subtrees.push_back(TreeExecutor<C,LC,DC>(m_ctx,child));
-                }
-            }
+        case NodeKind::SEQUENCE:
+        case NodeKind::SELECTOR:
+            __BT_TREE_GOTO_TRAVERSE(TraversalMode::TRAVERSAL)
+        case NodeKind::MULTIPLEXER:
+            EnterSubtrees(childNode);
+            __BT_TREE_GOTO_EXECUTE()
+        default:
             __BT_TREE_GOTO_EXECUTE()
         }
     }
@@ -462,26 +2563,88 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
         NodeStackEntry<C,LC,DC>& entry = m_nodeStack[m_nodeStack.size() - 1];
         if (!m_endTimer.HasPassed(now))
         {
-            return;
+            return false;
         }
 
-        if (Leaf<C,LC,DC>* leaf = dynamic_cast<Leaf<C,LC,DC>*>(entry.m_node))
+        CompiledNode const& executed = tree.m_nodes[entry.m_node];
+        switch (executed.m_kind)
+        {
+        case NodeKind::LEAF:
+        {
+            __BT_TREE_PROFILE(uint64_t profileStart = BTProfileNow();)
+            if (!batchReady && batch && tree.m_batchCallbacks[executed.m_callback])
+            {
+                batch->Queue(tree.m_batchCallbacks[executed.m_callback].get(), this, ctx, entry.m_memory);
+                m_suspension = Suspension::BATCH;
+                m_batchWait = true;
+                return true;
+            }
+            // only the leaf that waited takes the batch result
+            int res = std::exchange(batchReady, false) ? m_batchResult
+                : entry.m_slabOffset != TreeSlab::NONE
+                ? tree.m_typedCallbacks[executed.m_callback].m_callback(ctx, m_slab.At(entry.m_slabOffset))
+                : memo->Call(tree.m_callbackMemos[executed.m_callback], tree.m_callbacks[executed.m_callback], ctx, entry.m_memory);
+            __BT_TREE_PROFILE(tree.RecordCall(entry.m_node, res, BTProfileNow() - profileStart);)
+            __BT_TREE_TRACE(CALL, entry.m_node, res)
+            switch (res)
+            {
+            case Result::SUCCESS:
+            case Result::FAILURE:
+                __BT_TREE_GOTO_REBUILD(int(m_nodeStack.size()) - 2, Result(res))
+                break;
+            default:
+                m_endTimer.Set(now, res);
+                return false;
+            }
+        }
+#ifdef BT_COROUTINES
+        case NodeKind::COROUTINE_LEAF:
         {
-            int res = leaf->m_exec(ctx,entry.m_memory);
+            __BT_TREE_PROFILE(uint64_t profileStart = BTProfileNow();)
+            int res;
+            {
+                TreeFramePoolScope scope(m_framePool);
+                if (entry.m_task.IsEmpty())
+                {
+                    entry.m_task = tree.m_coroutines[executed.m_callback](ctx);
+                }
+                try
+                {
+                    res = entry.m_task.Resume();
+                }
+                catch (...)
+                {
+                    // the next update starts the leaf again
+                    entry.m_task = TreeTask();
+                    throw;
+                }
+            }
+            __BT_TREE_PROFILE(tree.RecordCall(entry.m_node, res, BTProfileNow() - profileStart);)
+            __BT_TREE_TRACE(CALL, entry.m_node, res)
+            if (entry.m_task.IsDone() && res != Result::SUCCESS && res != Result::FAILURE)
+            {
+                entry.m_task = TreeTask();
+                throw std::runtime_error("Coroutine leaves must co_return SUCCESS or FAILURE");
+            }
             switch (res)
             {
             case Result::SUCCESS:
             case Result::FAILURE:
+                // popping the entry destroys the frame
                 __BT_TREE_GOTO_REBUILD(int(m_nodeStack.size()) - 2, Result(res))
                 break;
             default:
                 m_endTimer.Set(now, res);
-                return;
+                return false;
             }
         }
-        else if (Multiplexer<C,LC,DC>* multiplexer = dynamic_cast<Multiplexer<C,LC,DC>*>(entry.m_node))
+#endif
+        case NodeKind::MULTIPLEXER:
         {
-            int res = multiplexer->m_callback ? multiplexer->m_callback(ctx,entry.m_memory) : 0;
+            __BT_TREE_PROFILE(uint64_t profileStart = BTProfileNow();)
+            int res = executed.m_callback != CompiledNode::NO_CALLBACK ? memo->Call(tree.m_callbackMemos[executed.m_callback], tree.m_callbacks[executed.m_callback], ctx, entry.m_memory) : 0;
+            __BT_TREE_PROFILE(tree.RecordCall(entry.m_node, res, BTProfileNow() - profileStart);)
+            __BT_TREE_TRACE(CALL, entry.m_node, res)
             switch (res)
             {
             case Result::SUCCESS:
@@ -490,15 +2653,10 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
                 break;
             default:
                 m_endTimer.Set(now, res);
-                for (TreeExecutor<C,LC,DC>& tree : m_subtrees)
-                {
-                    tree.Update(ctx, now);
-                }
-                return;
+                return UpdateSubtrees(ctx, now, budget, memo, batch, 0);
             }
         }
-        else
-        {
+        default:
             throw std::runtime_error("Unhandled unknown Node subclass");
         }
     }
@@ -514,5 +2672,6 @@ void TreeExecutor<C,LC,DC>::Update(C& ctx, uint64_t now)
 #undef __BT_TREE_GOTO_TRAVERSE
 #undef __BT_TREE_GOTO_ADD_CHILD
 #undef __BT_TREE_GOTO_EXECUTE
+#undef __BT_TREE_PROFILE
+#undef __BT_TREE_TRACE
 }
-
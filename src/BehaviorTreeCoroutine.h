@@ -0,0 +1,133 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+//
+// Coroutine Leaves
+//
+
+// Frame allocator of a single executor. Frames are recycled through free
+// lists by size class, so a leaf that is entered again reuses the frame of
+// its last run instead of allocating. Frames remember the pool they came
+// from, and the pool's memory is kept alive until the last one is freed.
+// Copies start out empty.
+class TreeFramePool
+{
+public:
+    TreeFramePool() = default;
+    TreeFramePool(TreeFramePool const& other);
+    TreeFramePool(TreeFramePool&& other) noexcept;
+    TreeFramePool& operator=(TreeFramePool const& other);
+    TreeFramePool& operator=(TreeFramePool&& other) noexcept;
+    ~TreeFramePool();
+    // Frames allocated from this pool and not freed yet
+    size_t LiveFrames() const;
+    // Frames that could not be taken from a free list
+    size_t Allocations() const;
+
+    // Allocate from the pool of the innermost TreeFramePoolScope on this
+    // thread, or from the global heap if there is none
+    static void* Allocate(size_t size);
+    static void Deallocate(void* frame);
+private:
+    struct Blocks;
+    struct FrameHeader;
+    void Release();
+    static TreeFramePool*& Current();
+    Blocks* m_blocks = nullptr;
+    friend class TreeFramePoolScope;
+};
+
+// Makes "pool" the one coroutine frames are allocated from on this thread
+class TreeFramePoolScope
+{
+public:
+    explicit TreeFramePoolScope(TreeFramePool& pool);
+    ~TreeFramePoolScope();
+    TreeFramePoolScope(TreeFramePoolScope const&) = delete;
+    TreeFramePoolScope& operator=(TreeFramePoolScope const&) = delete;
+private:
+    TreeFramePool* m_previous;
+};
+
+// Awaited by a coroutine leaf to wait, like a leaf returning "m_delay".
+// A delay of 0 resumes the leaf on the next update.
+struct TreeDelay
+{
+    int m_delay;
+};
+
+// Coroutine a leaf runs (see BranchNode::AddCoroutineLeaf). It can
+// co_await a TreeDelay, or another TreeTask which then runs as part of it
+// and whose result the co_await returns. It must co_return SUCCESS or
+// FAILURE. Destroying a task destroys its frame and those of the tasks it
+// is awaiting. Copies are empty.
+class TreeTask
+{
+public:
+    struct promise_type;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        int m_result = 0;
+        int m_delay = 0;
+        // outermost task, which holds the delay and the innermost task
+        promise_type* m_root = this;
+        std::coroutine_handle<> m_current;
+        std::coroutine_handle<> m_continuation;
+        std::exception_ptr m_exception;
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept;
+            std::coroutine_handle<> await_suspend(Handle handle) noexcept;
+            void await_resume() noexcept;
+        };
+        struct DelayAwaiter
+        {
+            int m_delay;
+            bool await_ready() noexcept;
+            void await_suspend(Handle handle) noexcept;
+            void await_resume() noexcept;
+        };
+        struct TaskAwaiter
+        {
+            Handle m_task;
+            bool await_ready() noexcept;
+            std::coroutine_handle<> await_suspend(Handle handle) noexcept;
+            int await_resume();
+        };
+
+        TreeTask get_return_object();
+        std::suspend_always initial_suspend() noexcept;
+        FinalAwaiter final_suspend() noexcept;
+        void return_value(int result);
+        void unhandled_exception();
+        // only delays and other tasks can be awaited
+        DelayAwaiter await_transform(TreeDelay delay);
+        TaskAwaiter await_transform(TreeTask&& task);
+        static void* operator new(size_t size);
+        static void operator delete(void* frame);
+    };
+
+    TreeTask() = default;
+    TreeTask(TreeTask const& other);
+    TreeTask(TreeTask&& other) noexcept;
+    TreeTask& operator=(TreeTask const& other);
+    TreeTask& operator=(TreeTask&& other) noexcept;
+    ~TreeTask();
+    bool IsEmpty() const;
+    bool IsDone() const;
+    // Runs the task until it awaits a delay, which is returned, or ends,
+    // in which case its result is returned. Rethrows what the task threw.
+    int Resume();
+private:
+    explicit TreeTask(Handle handle);
+    Handle m_handle;
+};
+
+#include "BehaviorTreeCoroutine.ipp"
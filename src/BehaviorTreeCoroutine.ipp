@@ -0,0 +1,362 @@
+#pragma once
+
+#include "BehaviorTreeCoroutine.h"
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+//
+// Frame Pools
+//
+
+// Size classes are powers of two from 64 bytes up, frames larger than the
+// largest class are not pooled
+struct TreeFramePool::Blocks
+{
+    static constexpr size_t MIN_SIZE = 64;
+    static constexpr uint32_t CLASS_COUNT = 7;
+    void* m_free[CLASS_COUNT] = {};
+    size_t m_live = 0;
+    size_t m_allocations = 0;
+    // the pool is gone, delete once the last frame is freed
+    bool m_orphaned = false;
+
+    ~Blocks()
+    {
+        for (void* block : m_free)
+        {
+            while (block)
+            {
+                void* next = *static_cast<void**>(block);
+                ::operator delete(block);
+                block = next;
+            }
+        }
+    }
+};
+
+struct alignas(std::max_align_t) TreeFramePool::FrameHeader
+{
+    static constexpr uint32_t UNPOOLED = UINT32_MAX;
+    Blocks* m_blocks;
+    uint32_t m_class;
+};
+
+inline TreeFramePool::TreeFramePool(TreeFramePool const&)
+{}
+
+inline TreeFramePool::TreeFramePool(TreeFramePool&& other) noexcept
+    : m_blocks(other.m_blocks)
+{
+    other.m_blocks = nullptr;
+}
+
+inline TreeFramePool& TreeFramePool::operator=(TreeFramePool const& other)
+{
+    if (this != &other)
+    {
+        Release();
+    }
+    return *this;
+}
+
+inline TreeFramePool& TreeFramePool::operator=(TreeFramePool&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_blocks = other.m_blocks;
+        other.m_blocks = nullptr;
+    }
+    return *this;
+}
+
+inline TreeFramePool::~TreeFramePool()
+{
+    Release();
+}
+
+inline void TreeFramePool::Release()
+{
+    if (m_blocks && m_blocks->m_live == 0)
+    {
+        delete m_blocks;
+    }
+    else if (m_blocks)
+    {
+        m_blocks->m_orphaned = true;
+    }
+    m_blocks = nullptr;
+}
+
+inline size_t TreeFramePool::LiveFrames() const
+{
+    return m_blocks ? m_blocks->m_live : 0;
+}
+
+inline size_t TreeFramePool::Allocations() const
+{
+    return m_blocks ? m_blocks->m_allocations : 0;
+}
+
+inline TreeFramePool*& TreeFramePool::Current()
+{
+    thread_local TreeFramePool* current = nullptr;
+    return current;
+}
+
+inline void* TreeFramePool::Allocate(size_t size)
+{
+    size += sizeof(FrameHeader);
+    uint32_t sizeClass = 0;
+    while (sizeClass < Blocks::CLASS_COUNT && (Blocks::MIN_SIZE << sizeClass) < size)
+    {
+        sizeClass++;
+    }
+
+    TreeFramePool* pool = Current();
+    FrameHeader* header;
+    if (pool == nullptr || sizeClass == Blocks::CLASS_COUNT)
+    {
+        header = static_cast<FrameHeader*>(::operator new(size));
+        header->m_blocks = nullptr;
+        header->m_class = FrameHeader::UNPOOLED;
+        return header + 1;
+    }
+
+    if (pool->m_blocks == nullptr)
+    {
+        pool->m_blocks = new Blocks();
+    }
+    Blocks& blocks = *pool->m_blocks;
+    if (void* block = blocks.m_free[sizeClass])
+    {
+        blocks.m_free[sizeClass] = *static_cast<void**>(block);
+        header = static_cast<FrameHeader*>(block);
+    }
+    else
+    {
+        header = static_cast<FrameHeader*>(::operator new(Blocks::MIN_SIZE << sizeClass));
+        blocks.m_allocations++;
+    }
+    header->m_blocks = &blocks;
+    header->m_class = sizeClass;
+    blocks.m_live++;
+    return header + 1;
+}
+
+inline void TreeFramePool::Deallocate(void* frame)
+{
+    FrameHeader* header = static_cast<FrameHeader*>(frame) - 1;
+    Blocks* blocks = header->m_blocks;
+    if (blocks == nullptr)
+    {
+        ::operator delete(header);
+        return;
+    }
+    uint32_t sizeClass = header->m_class;
+    *reinterpret_cast<void**>(header) = blocks->m_free[sizeClass];
+    blocks->m_free[sizeClass] = header;
+    blocks->m_live--;
+    if (blocks->m_orphaned && blocks->m_live == 0)
+    {
+        delete blocks;
+    }
+}
+
+inline TreeFramePoolScope::TreeFramePoolScope(TreeFramePool& pool)
+    : m_previous(TreeFramePool::Current())
+{
+    TreeFramePool::Current() = &pool;
+}
+
+inline TreeFramePoolScope::~TreeFramePoolScope()
+{
+    TreeFramePool::Current() = m_previous;
+}
+
+//
+// Tasks
+//
+
+inline TreeTask TreeTask::promise_type::get_return_object()
+{
+    m_current = Handle::from_promise(*this);
+    return TreeTask(Handle::from_promise(*this));
+}
+
+inline std::suspend_always TreeTask::promise_type::initial_suspend() noexcept
+{
+    return {};
+}
+
+inline TreeTask::promise_type::FinalAwaiter TreeTask::promise_type::final_suspend() noexcept
+{
+    return {};
+}
+
+inline void TreeTask::promise_type::return_value(int result)
+{
+    m_result = result;
+}
+
+inline void TreeTask::promise_type::unhandled_exception()
+{
+    m_exception = std::current_exception();
+}
+
+inline TreeTask::promise_type::DelayAwaiter TreeTask::promise_type::await_transform(TreeDelay delay)
+{
+    return { delay.m_delay };
+}
+
+inline TreeTask::promise_type::TaskAwaiter TreeTask::promise_type::await_transform(TreeTask&& task)
+{
+    if (task.IsEmpty() || task.IsDone())
+    {
+        throw std::runtime_error("Awaited a TreeTask that is empty or already done");
+    }
+    return { task.m_handle };
+}
+
+inline void* TreeTask::promise_type::operator new(size_t size)
+{
+    return TreeFramePool::Allocate(size);
+}
+
+inline void TreeTask::promise_type::operator delete(void* frame)
+{
+    TreeFramePool::Deallocate(frame);
+}
+
+inline bool TreeTask::promise_type::FinalAwaiter::await_ready() noexcept
+{
+    return false;
+}
+
+// an awaited task continues the one awaiting it, the outermost one returns
+// to TreeTask::Resume
+inline std::coroutine_handle<> TreeTask::promise_type::FinalAwaiter::await_suspend(Handle handle) noexcept
+{
+    promise_type& promise = handle.promise();
+    if (promise.m_continuation)
+    {
+        promise.m_root->m_current = promise.m_continuation;
+        return promise.m_continuation;
+    }
+    return std::noop_coroutine();
+}
+
+inline void TreeTask::promise_type::FinalAwaiter::await_resume() noexcept
+{}
+
+inline bool TreeTask::promise_type::DelayAwaiter::await_ready() noexcept
+{
+    return false;
+}
+
+inline void TreeTask::promise_type::DelayAwaiter::await_suspend(Handle handle) noexcept
+{
+    promise_type& root = *handle.promise().m_root;
+    root.m_delay = m_delay;
+    root.m_current = handle;
+}
+
+inline void TreeTask::promise_type::DelayAwaiter::await_resume() noexcept
+{}
+
+inline bool TreeTask::promise_type::TaskAwaiter::await_ready() noexcept
+{
+    return false;
+}
+
+inline std::coroutine_handle<> TreeTask::promise_type::TaskAwaiter::await_suspend(Handle handle) noexcept
+{
+    promise_type& task = m_task.promise();
+    task.m_root = handle.promise().m_root;
+    task.m_continuation = handle;
+    task.m_root->m_current = m_task;
+    return m_task;
+}
+
+inline int TreeTask::promise_type::TaskAwaiter::await_resume()
+{
+    promise_type& task = m_task.promise();
+    if (task.m_exception)
+    {
+        std::rethrow_exception(task.m_exception);
+    }
+    return task.m_result;
+}
+
+inline TreeTask::TreeTask(Handle handle)
+    : m_handle(handle)
+{}
+
+inline TreeTask::TreeTask(TreeTask const&)
+{}
+
+inline TreeTask::TreeTask(TreeTask&& other) noexcept
+    : m_handle(std::exchange(other.m_handle, nullptr))
+{}
+
+inline TreeTask& TreeTask::operator=(TreeTask const& other)
+{
+    if (this != &other && m_handle)
+    {
+        m_handle.destroy();
+        m_handle = nullptr;
+    }
+    return *this;
+}
+
+inline TreeTask& TreeTask::operator=(TreeTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_handle)
+        {
+            m_handle.destroy();
+        }
+        m_handle = std::exchange(other.m_handle, nullptr);
+    }
+    return *this;
+}
+
+inline TreeTask::~TreeTask()
+{
+    if (m_handle)
+    {
+        m_handle.destroy();
+    }
+}
+
+inline bool TreeTask::IsEmpty() const
+{
+    return !m_handle;
+}
+
+inline bool TreeTask::IsDone() const
+{
+    return m_handle && m_handle.done();
+}
+
+inline int TreeTask::Resume()
+{
+    if (IsEmpty() || IsDone())
+    {
+        throw std::runtime_error("Resumed a TreeTask that is empty or already done");
+    }
+    promise_type& root = m_handle.promise();
+    root.m_current.resume();
+    if (m_handle.done())
+    {
+        if (root.m_exception)
+        {
+            std::rethrow_exception(root.m_exception);
+        }
+        return root.m_result;
+    }
+    return root.m_delay;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "BehaviorTree.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <thread>
+#include <type_traits>
+
+//
+// Thread Pool
+//
+
+// Fixed set of worker threads that split index ranges between them. Each
+// worker starts on its own contiguous share of the range and steals chunks
+// from the other workers once it runs out.
+class TreeThreadPool
+{
+public:
+    // "threads" includes the calling thread, which always takes part in work.
+    TreeThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~TreeThreadPool();
+    TreeThreadPool(TreeThreadPool const&) = delete;
+    TreeThreadPool& operator=(TreeThreadPool const&) = delete;
+
+    size_t ThreadCount() const;
+    // Calls fn(begin, end) for chunks of at most "grain" indices covering
+    // [0, count) and blocks until all of them are done. The first exception
+    // thrown by fn is rethrown here.
+    void ParallelFor(size_t count, size_t grain, std::function<void(size_t, size_t)> const& fn);
+private:
+    struct Chunk
+    {
+        size_t m_begin;
+        size_t m_end;
+    };
+    struct Queue
+    {
+        std::mutex m_mutex;
+        std::deque<Chunk> m_chunks;
+    };
+
+    void WorkerLoop(size_t worker);
+    void RunChunks(size_t worker);
+    bool PopChunk(size_t worker, Chunk& chunk);
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::function<void(size_t, size_t)> const* m_job = nullptr;
+    std::exception_ptr m_error;
+    std::mutex m_errorMutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    uint64_t m_generation = 0;
+    size_t m_active = 0;
+    bool m_stopping = false;
+};
+
+//
+// Batch Update
+//
+
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+struct ExecutorBinding
+{
+    TreeExecutor<C,LC,DC>* m_executor;
+    std::remove_reference_t<C>* m_context;
+};
+
+// Updates every executor in "bindings" on the threads of "pool".
+//
+// Every executor must be built from a frozen BehaviorTreeContext (or
+// directly from a CompiledTree), and no executor or game context may appear
+// in more than one binding. Callbacks run concurrently and must only touch
+// the context and memory they are passed.
+template <typename C, typename LC, typename DC>
+void UpdateAll(TreeThreadPool& pool, ExecutorBinding<C,LC,DC>* bindings, size_t count, uint64_t now, size_t grain = 64);
+
+#include "BehaviorTreeParallel.ipp"
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "BehaviorTreeParallel.h"
+
+#include <stdexcept>
+
+//
+// Thread Pool
+//
+
+inline TreeThreadPool::TreeThreadPool(size_t threads)
+{
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+    // worker 0 is the thread calling ParallelFor
+    for (size_t i = 1; i < threads; ++i)
+    {
+        m_threads.emplace_back([this, i]() { WorkerLoop(i); });
+    }
+}
+
+inline TreeThreadPool::~TreeThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_start.notify_all();
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+inline size_t TreeThreadPool::ThreadCount() const
+{
+    return m_queues.size();
+}
+
+inline void TreeThreadPool::ParallelFor(size_t count, size_t grain, std::function<void(size_t, size_t)> const& fn)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+
+    // hand every worker a contiguous share so agents next to each other in
+    // memory are usually updated by the same thread
+    size_t chunks = (count + grain - 1) / grain;
+    size_t workers = m_queues.size();
+    for (size_t worker = 0; worker < workers; ++worker)
+    {
+        size_t first = chunks * worker / workers;
+        size_t last = chunks * (worker + 1) / workers;
+        std::lock_guard<std::mutex> lock(m_queues[worker]->m_mutex);
+        for (size_t chunk = first; chunk < last; ++chunk)
+        {
+            m_queues[worker]->m_chunks.push_back({ chunk * grain, std::min(count, (chunk + 1) * grain) });
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &fn;
+        m_error = nullptr;
+        m_active = m_threads.size();
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    RunChunks(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_active == 0; });
+    m_job = nullptr;
+    if (m_error)
+    {
+        std::rethrow_exception(m_error);
+    }
+}
+
+inline void TreeThreadPool::WorkerLoop(size_t worker)
+{
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+            if (m_stopping)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        RunChunks(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active--;
+        }
+        m_done.notify_one();
+    }
+}
+
+inline void TreeThreadPool::RunChunks(size_t worker)
+{
+    Chunk chunk;
+    while (PopChunk(worker, chunk))
+    {
+        try
+        {
+            (*m_job)(chunk.m_begin, chunk.m_end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_errorMutex);
+            if (!m_error)
+            {
+                m_error = std::current_exception();
+            }
+        }
+    }
+}
+
+inline bool TreeThreadPool::PopChunk(size_t worker, Chunk& chunk)
+{
+    {
+        Queue& own = *m_queues[worker];
+        std::lock_guard<std::mutex> lock(own.m_mutex);
+        if (own.m_chunks.size() > 0)
+        {
+            chunk = own.m_chunks.front();
+            own.m_chunks.pop_front();
+            return true;
+        }
+    }
+    // steal from the far end of someone else's share
+    for (size_t i = 1; i < m_queues.size(); ++i)
+    {
+        Queue& victim = *m_queues[(worker + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.m_mutex);
+        if (victim.m_chunks.size() > 0)
+        {
+            chunk = victim.m_chunks.back();
+            victim.m_chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Batch Update
+//
+
+template <typename C, typename LC, typename DC>
+void UpdateAll(TreeThreadPool& pool, ExecutorBinding<C,LC,DC>* bindings, size_t count, uint64_t now, size_t grain)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!bindings[i].m_executor->IsThreadSafe())
+        {
+            throw std::runtime_error("UpdateAll requires executors of a frozen BehaviorTreeContext");
+        }
+    }
+    pool.ParallelFor(count, grain, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+        {
+            bindings[i].m_executor->Update(*bindings[i].m_context, now);
+        }
+    });
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "BehaviorTree.h"
+
+#include <optional>
+
+//
+// Executor Pool
+//
+
+// Fixed-capacity set of executors that all run the same compiled tree.
+//
+// The node and decorator stacks of every agent live in two preallocated
+// slabs, each agent owning a block sized by the trees maximum depth, so
+// creating and destroying agents never allocates and agents created after
+// each other sit next to each other in memory. Multiplexer subtrees still
+// allocate their own stacks.
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class ExecutorPool
+{
+public:
+    using Handle = uint32_t;
+
+    // Throws if the tree is recursive and so has no maximum depth.
+    ExecutorPool(std::shared_ptr<CompiledTree<C,LC,DC> const> tree, size_t capacity);
+    ~ExecutorPool();
+    ExecutorPool(ExecutorPool const&) = delete;
+    ExecutorPool& operator=(ExecutorPool const&) = delete;
+
+    // Throws if the pool is full.
+    Handle Create();
+    void Destroy(Handle handle);
+    TreeExecutor<C,LC,DC>& Get(Handle handle);
+    void Update(Handle handle, C& ctx, uint64_t now);
+
+    size_t Size() const;
+    size_t Capacity() const;
+private:
+    std::shared_ptr<CompiledTree<C,LC,DC> const> m_tree;
+    size_t m_capacity;
+    size_t m_nodeDepth;
+    size_t m_decoratorDepth;
+    NodeStackEntry<C,LC,DC>* m_nodeSlab = nullptr;
+    DecoratorStackEntry<DC>* m_decoratorSlab = nullptr;
+    std::vector<std::optional<TreeExecutor<C,LC,DC>>> m_executors;
+    std::vector<Handle> m_free;
+};
+
+#include "BehaviorTreePool.ipp"
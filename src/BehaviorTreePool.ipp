@@ -0,0 +1,86 @@
+#pragma once
+
+#include "BehaviorTreePool.h"
+
+#include <stdexcept>
+
+template <typename C, typename LC, typename DC>
+ExecutorPool<C,LC,DC>::ExecutorPool(std::shared_ptr<CompiledTree<C,LC,DC> const> tree, size_t capacity)
+    : m_tree(tree)
+    , m_capacity(capacity)
+    , m_nodeDepth(tree->MaxNodeDepth())
+    , m_decoratorDepth(tree->MaxDecoratorDepth())
+{
+    if (tree->MaxNodeDepth() == CompiledTree<C,LC,DC>::UNBOUNDED)
+    {
+        throw std::runtime_error("ExecutorPool cannot hold recursive trees");
+    }
+    m_nodeSlab = std::allocator<NodeStackEntry<C,LC,DC>>().allocate(m_capacity * m_nodeDepth);
+    m_decoratorSlab = std::allocator<DecoratorStackEntry<DC>>().allocate(std::max<size_t>(m_capacity * m_decoratorDepth, 1));
+    m_executors.resize(m_capacity);
+    m_free.reserve(m_capacity);
+    // hand out low handles first
+    for (size_t i = m_capacity; i > 0; --i)
+    {
+        m_free.push_back(Handle(i - 1));
+    }
+}
+
+template <typename C, typename LC, typename DC>
+ExecutorPool<C,LC,DC>::~ExecutorPool()
+{
+    // executors destroy the entries they hold in the slabs
+    m_executors.clear();
+    std::allocator<NodeStackEntry<C,LC,DC>>().deallocate(m_nodeSlab, m_capacity * m_nodeDepth);
+    std::allocator<DecoratorStackEntry<DC>>().deallocate(m_decoratorSlab, std::max<size_t>(m_capacity * m_decoratorDepth, 1));
+}
+
+template <typename C, typename LC, typename DC>
+typename ExecutorPool<C,LC,DC>::Handle ExecutorPool<C,LC,DC>::Create()
+{
+    if (m_free.size() == 0)
+    {
+        throw std::runtime_error("ExecutorPool is full");
+    }
+    Handle handle = m_free.back();
+    m_free.pop_back();
+    TreeExecutor<C,LC,DC>& executor = m_executors[handle].emplace(TreeExecutor<C,LC,DC>(m_tree.get(), 0));
+    executor.m_nodeStack = TreeStack<NodeStackEntry<C,LC,DC>>(m_nodeSlab + handle * m_nodeDepth, m_nodeDepth);
+    executor.m_decoratorStack = TreeStack<DecoratorStackEntry<DC>>(m_decoratorSlab + handle * m_decoratorDepth, m_decoratorDepth);
+    return handle;
+}
+
+template <typename C, typename LC, typename DC>
+void ExecutorPool<C,LC,DC>::Destroy(Handle handle)
+{
+    if (!m_executors[handle].has_value())
+    {
+        throw std::runtime_error("Destroying an executor that is not in use");
+    }
+    m_executors[handle].reset();
+    m_free.push_back(handle);
+}
+
+template <typename C, typename LC, typename DC>
+TreeExecutor<C,LC,DC>& ExecutorPool<C,LC,DC>::Get(Handle handle)
+{
+    return *m_executors[handle];
+}
+
+template <typename C, typename LC, typename DC>
+void ExecutorPool<C,LC,DC>::Update(Handle handle, C& ctx, uint64_t now)
+{
+    m_executors[handle]->Update(ctx, now);
+}
+
+template <typename C, typename LC, typename DC>
+size_t ExecutorPool<C,LC,DC>::Size() const
+{
+    return m_capacity - m_free.size();
+}
+
+template <typename C, typename LC, typename DC>
+size_t ExecutorPool<C,LC,DC>::Capacity() const
+{
+    return m_capacity;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "BehaviorTree.h"
+
+#include <deque>
+#include <type_traits>
+
+//
+// Scheduler
+//
+
+// Updates large numbers of executors without touching the ones that have
+// nothing to do. Every executor is kept in a hierarchical timer wheel keyed
+// on TreeExecutor::NextUpdateTime, so a Tick only costs time proportional
+// to the executors that are actually due.
+//
+// The scheduler only references executors and contexts, both must outlive
+// their registration.
+template <typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class TreeScheduler
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+    TreeScheduler(uint64_t now = 0);
+
+    // Registers an executor, it is updated on the next Tick.
+    Handle Add(TreeExecutor<C,LC,DC>* executor, C& ctx);
+    void Remove(Handle handle);
+    // Makes an executor due on the next Tick, regardless of its timers.
+    void Wake(Handle handle);
+    // Notifies the executor of "event" (see TreeExecutor::Notify) and makes
+    // it due accordingly.
+    void Notify(Handle handle, TreeEventId event);
+    // Changes the executors tick interval (see TreeExecutor::SetTickInterval)
+    // and reschedules it accordingly.
+    void SetTickInterval(Handle handle, uint64_t interval);
+    // Updates every executor that is due at "now" and returns how many were
+    // updated. Rethrows what an update throws, the executor that threw and
+    // those not updated yet are the first to be updated on the next Tick.
+    size_t Tick(uint64_t now);
+    // Like Tick, but stops once "frame" runs out and gives no executor more
+    // than "perExecutor" transitions of it. Executors that were suspended or
+    // not reached are the first to be updated on the next Tick.
+    size_t Tick(uint64_t now, UpdateBudget& frame, uint64_t perExecutor = UINT64_MAX);
+    // Executors reaching a batched leaf (see BranchNode::AddBatchLeaf)
+    // during a Tick wait until every due executor has been updated, then
+    // each batched callback is called once for all executors waiting on it
+    // and those continue. This repeats until no executor is waiting. Off by
+    // default, in which case batched leaves are called one executor at a time.
+    void SetLeafBatching(bool enabled);
+    // Gives every registered executor created with "oldRoot" (or last given
+    // it) "newRoot" instead (see TreeExecutor::ReplaceTree), "perTick" of
+    // them at the start of every Tick so that reloading a tree many
+    // executors run is spread over several frames. The others keep running
+    // "oldRoot" until their turn comes. Replacements queued while another
+    // is in progress start once it is done.
+    void ReplaceTree(Node<C,LC,DC>* oldRoot, Node<C,LC,DC>* newRoot, size_t perTick = 256);
+    // True while a ReplaceTree has executors left to replace
+    bool IsReplacingTree() const;
+    size_t Size() const;
+private:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS;
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Entry
+    {
+        TreeExecutor<C,LC,DC>* m_executor;
+        std::remove_reference_t<C>* m_context;
+        uint64_t m_deadline = 0;
+        uint32_t m_prev = NONE;
+        uint32_t m_next = NONE;
+        uint8_t m_level = 0;
+        uint8_t m_slot = 0;
+        bool m_linked = false;
+    };
+
+    void Insert(Handle handle, uint64_t deadline);
+    void Unlink(Handle handle);
+    // Moves everything due at "now" out of the wheel into m_due
+    void Collect(uint64_t now);
+    // Continues the oldest ReplaceTree
+    void Replace();
+
+    uint64_t m_elapsed;
+    size_t m_size = 0;
+    std::vector<Entry> m_entries;
+    std::vector<Handle> m_free;
+    std::vector<Handle> m_due;
+    // due but left over by a budgeted Tick, in the order to update them
+    std::vector<Handle> m_deferred;
+    bool m_batching = false;
+    LeafBatch<C,LC,DC> m_batch;
+    // waiting on m_batch
+    std::vector<Handle> m_batched;
+    struct Replacement
+    {
+        Node<C,LC,DC>* m_oldRoot;
+        Node<C,LC,DC>* m_newRoot;
+        size_t m_perTick;
+        // entries before it have been replaced
+        Handle m_next = 0;
+    };
+    std::deque<Replacement> m_replacements;
+    uint64_t m_occupied[LEVELS] = {};
+    uint32_t m_slots[LEVELS][SLOTS];
+};
+
+#include "BehaviorTreeScheduler.ipp"
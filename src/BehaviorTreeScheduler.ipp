@@ -0,0 +1,380 @@
+#pragma once
+
+#include "BehaviorTreeScheduler.h"
+
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline int BTCountTrailingZeros(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return int(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+inline int BTCountLeadingZeros(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - int(index);
+#else
+    return __builtin_clzll(value);
+#endif
+}
+
+template <typename C, typename LC, typename DC>
+TreeScheduler<C,LC,DC>::TreeScheduler(uint64_t now)
+    : m_elapsed(now)
+{
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        std::fill(m_slots[level], m_slots[level] + SLOTS, NONE);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+typename TreeScheduler<C,LC,DC>::Handle TreeScheduler<C,LC,DC>::Add(TreeExecutor<C,LC,DC>* executor, C& ctx)
+{
+    Handle handle;
+    if (m_free.size() > 0)
+    {
+        handle = m_free.back();
+        m_free.pop_back();
+        m_entries[handle] = Entry();
+    }
+    else
+    {
+        handle = Handle(m_entries.size());
+        m_entries.emplace_back();
+    }
+    m_entries[handle].m_executor = executor;
+    m_entries[handle].m_context = &ctx;
+    m_size++;
+    Insert(handle, m_elapsed);
+    return handle;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Remove(Handle handle)
+{
+    Entry& entry = m_entries[handle];
+    if (entry.m_executor == nullptr)
+    {
+        throw std::runtime_error("Removing an executor that is not scheduled");
+    }
+    if (entry.m_linked)
+    {
+        Unlink(handle);
+    }
+    entry.m_executor = nullptr;
+    m_free.push_back(handle);
+    m_size--;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Wake(Handle handle)
+{
+    if (m_entries[handle].m_linked)
+    {
+        Unlink(handle);
+        Insert(handle, m_elapsed);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Notify(Handle handle, TreeEventId event)
+{
+    Entry& entry = m_entries[handle];
+    entry.m_executor->Notify(event);
+    uint64_t next = std::max(entry.m_executor->NextUpdateTime(), m_elapsed);
+    if (entry.m_linked && next < entry.m_deadline)
+    {
+        Unlink(handle);
+        Insert(handle, next);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::SetTickInterval(Handle handle, uint64_t interval)
+{
+    Entry& entry = m_entries[handle];
+    entry.m_executor->SetTickInterval(interval);
+    if (entry.m_linked)
+    {
+        Unlink(handle);
+        Insert(handle, entry.m_executor->NextUpdateTime());
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::SetLeafBatching(bool enabled)
+{
+    m_batching = enabled;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::ReplaceTree(Node<C,LC,DC>* oldRoot, Node<C,LC,DC>* newRoot, size_t perTick)
+{
+    if (perTick == 0)
+    {
+        throw std::runtime_error("Replacing a tree needs at least one executor per tick");
+    }
+    m_replacements.push_back({ oldRoot, newRoot, perTick });
+}
+
+template <typename C, typename LC, typename DC>
+bool TreeScheduler<C,LC,DC>::IsReplacingTree() const
+{
+    return !m_replacements.empty();
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Replace()
+{
+    Replacement& replacement = m_replacements.front();
+    size_t replaced = 0;
+    for (; replacement.m_next < m_entries.size() && replaced < replacement.m_perTick; ++replacement.m_next)
+    {
+        Handle handle = replacement.m_next;
+        TreeExecutor<C,LC,DC>* executor = m_entries[handle].m_executor;
+        if (executor == nullptr || executor->RootNode() != replacement.m_oldRoot)
+        {
+            continue;
+        }
+        executor->ReplaceTree(replacement.m_newRoot);
+        replaced++;
+        // executors that fell back to an ancestor are due right away
+        if (m_entries[handle].m_linked)
+        {
+            Unlink(handle);
+            Insert(handle, executor->NextUpdateTime());
+        }
+    }
+    if (replacement.m_next == m_entries.size())
+    {
+        m_replacements.pop_front();
+    }
+}
+
+template <typename C, typename LC, typename DC>
+size_t TreeScheduler<C,LC,DC>::Size() const
+{
+    return m_size;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Insert(Handle handle, uint64_t deadline)
+{
+    deadline = std::max(deadline, m_elapsed);
+    // entries are stored at the level of the highest bit they differ from
+    // the current time in, so every slot at or above the current position
+    // of a level only contains entries that are due in that slots range.
+    uint64_t masked = (deadline ^ m_elapsed) | (SLOTS - 1);
+    int level = (63 - BTCountLeadingZeros(masked)) / SLOT_BITS;
+    int slot = int((deadline >> (level * SLOT_BITS)) & (SLOTS - 1));
+
+    Entry& entry = m_entries[handle];
+    entry.m_deadline = deadline;
+    entry.m_level = uint8_t(level);
+    entry.m_slot = uint8_t(slot);
+    entry.m_prev = NONE;
+    entry.m_next = m_slots[level][slot];
+    entry.m_linked = true;
+    if (entry.m_next != NONE)
+    {
+        m_entries[entry.m_next].m_prev = handle;
+    }
+    m_slots[level][slot] = handle;
+    m_occupied[level] |= uint64_t(1) << slot;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Unlink(Handle handle)
+{
+    Entry& entry = m_entries[handle];
+    if (entry.m_prev != NONE)
+    {
+        m_entries[entry.m_prev].m_next = entry.m_next;
+    }
+    else
+    {
+        m_slots[entry.m_level][entry.m_slot] = entry.m_next;
+        if (entry.m_next == NONE)
+        {
+            m_occupied[entry.m_level] &= ~(uint64_t(1) << entry.m_slot);
+        }
+    }
+    if (entry.m_next != NONE)
+    {
+        m_entries[entry.m_next].m_prev = entry.m_prev;
+    }
+    entry.m_linked = false;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeScheduler<C,LC,DC>::Collect(uint64_t now)
+{
+    for (;;)
+    {
+        // the lowest occupied level always holds the earliest slot
+        int level = 0;
+        uint64_t occupied = 0;
+        for (; level < LEVELS; ++level)
+        {
+            int position = int((m_elapsed >> (level * SLOT_BITS)) & (SLOTS - 1));
+            occupied = m_occupied[level] & (~uint64_t(0) << position);
+            if (occupied)
+            {
+                break;
+            }
+        }
+        if (level == LEVELS)
+        {
+            break;
+        }
+
+        int slot = BTCountTrailingZeros(occupied);
+        int shift = level * SLOT_BITS;
+        uint64_t block = shift + SLOT_BITS >= 64 ? 0 : m_elapsed & ~((uint64_t(1) << (shift + SLOT_BITS)) - 1);
+        uint64_t slotStart = std::max(block + (uint64_t(slot) << shift), m_elapsed);
+        if (slotStart > now)
+        {
+            break;
+        }
+        m_elapsed = slotStart;
+
+        Handle handle = m_slots[level][slot];
+        m_slots[level][slot] = NONE;
+        m_occupied[level] &= ~(uint64_t(1) << slot);
+        while (handle != NONE)
+        {
+            Entry& entry = m_entries[handle];
+            Handle next = entry.m_next;
+            entry.m_linked = false;
+            if (entry.m_deadline <= now)
+            {
+                m_due.push_back(handle);
+            }
+            else
+            {
+                // cascades down into a lower level
+                Insert(handle, entry.m_deadline);
+            }
+            handle = next;
+        }
+    }
+    m_elapsed = now;
+}
+
+template <typename C, typename LC, typename DC>
+size_t TreeScheduler<C,LC,DC>::Tick(uint64_t now)
+{
+    UpdateBudget unlimited;
+    return Tick(now, unlimited);
+}
+
+template <typename C, typename LC, typename DC>
+size_t TreeScheduler<C,LC,DC>::Tick(uint64_t now, UpdateBudget& frame, uint64_t perExecutor)
+{
+    now = std::max(now, m_elapsed);
+    if (!m_replacements.empty())
+    {
+        Replace();
+    }
+    // whatever the last tick did not get to goes first
+    m_due.swap(m_deferred);
+    m_deferred.clear();
+    Collect(now);
+
+    size_t updated = 0;
+    // executors continuing after a batch were already counted
+    for (bool resumed = false; ; resumed = true)
+    {
+        for (size_t i = 0; i < m_due.size(); ++i)
+        {
+            Handle handle = m_due[i];
+            // removed or rescheduled by an earlier update this tick
+            if (m_entries[handle].m_executor == nullptr || m_entries[handle].m_linked)
+            {
+                continue;
+            }
+            if (frame.Exhausted())
+            {
+                m_deferred.push_back(handle);
+                continue;
+            }
+
+            UpdateBudget budget;
+            budget.m_transitions = std::min(perExecutor, frame.m_transitions);
+            budget.m_deadline = frame.m_deadline;
+            uint64_t given = budget.m_transitions;
+            TreeExecutor<C,LC,DC>* executor = m_entries[handle].m_executor;
+            bool suspended;
+            try
+            {
+                suspended = m_batching
+                    ? executor->Update(*m_entries[handle].m_context, now, budget, m_batch)
+                    : executor->Update(*m_entries[handle].m_context, now, budget);
+            }
+            catch (...)
+            {
+                // like executors a budget did not reach, everything not
+                // updated yet is kept for the next tick
+                m_deferred.push_back(handle);
+                m_deferred.insert(m_deferred.end(), m_due.begin() + i + 1, m_due.end());
+                m_deferred.insert(m_deferred.end(), m_batched.begin(), m_batched.end());
+                m_batched.clear();
+                // the waiting executors call their leaf on their own
+                m_batch.Clear();
+                throw;
+            }
+            if (frame.m_transitions != UINT64_MAX)
+            {
+                frame.m_transitions -= given - budget.m_transitions;
+            }
+            updated += resumed ? 0 : 1;
+
+            if (m_entries[handle].m_executor != nullptr && !m_entries[handle].m_linked)
+            {
+                if (executor->IsWaitingOnBatch())
+                {
+                    m_batched.push_back(handle);
+                }
+                else if (suspended)
+                {
+                    m_deferred.push_back(handle);
+                }
+                else
+                {
+                    Insert(handle, std::max(executor->NextUpdateTime(), now + 1));
+                }
+            }
+        }
+        if (m_batched.empty())
+        {
+            break;
+        }
+        try
+        {
+            m_batch.Run();
+        }
+        catch (...)
+        {
+            // kept scheduled, they call their leaf again next tick
+            m_deferred.insert(m_deferred.end(), m_batched.begin(), m_batched.end());
+            m_batched.clear();
+            throw;
+        }
+        m_due.swap(m_batched);
+        m_batched.clear();
+    }
+    return updated;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "BehaviorTree.h"
+
+#include <string>
+
+//
+// File Format
+//
+
+// Layout of a serialized tree, all integers are little endian:
+//
+//   TreeFileHeader
+//   CompiledNode    nodes[m_nodeCount]
+//   uint32_t        children[m_childCount]
+//   TreeFileSymbol  callbacks[m_callbackCount]
+//   TreeFileSymbol  decorators[m_decoratorCount]
+//   TreeFileSymbol  events[m_decoratorCount]      (since version 3)
+//   double          args[m_argCount]
+//   char            strings[m_stringBytes]
+//
+// Every table starts 8 byte aligned, so the node and child tables of a
+// mapped file can be used by executors as they are. Event symbols name the
+// event a decorator is re-evaluated on, they are empty for all others.
+struct TreeFileHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_nodeCount;
+    uint32_t m_childCount;
+    uint32_t m_callbackCount;
+    uint32_t m_decoratorCount;
+    uint32_t m_stringBytes;
+    uint32_t m_argCount;
+};
+
+// Name of a registered callback as a range of the string table, and its
+// arguments as a range of the argument table
+struct TreeFileSymbol
+{
+    uint32_t m_offset;
+    uint32_t m_length;
+    uint32_t m_argBegin;
+    uint32_t m_argCount;
+};
+
+//
+// Executor Snapshots
+//
+
+// Layout of a saved executor, integers are little endian and records are
+// packed without alignment:
+//
+//   TreeSnapshotHeader
+//   executor record, recursively:
+//     TreeSnapshotExecutor
+//     { TreeSnapshotNode, leaf memory }            [m_nodeCount]
+//     { TreeSnapshotDecorator, decorator memory }  [m_decoratorCount]
+//     executor record                              [m_subtreeCount]
+//
+// Timers are stored as the time elapsed since they were started, so they
+// can be restored against another clock.
+struct TreeSnapshotHeader
+{
+    uint32_t m_magic;
+    uint32_t m_version;
+    uint32_t m_treeNodeCount; // 0 if the executor never compiled its tree
+    uint32_t m_root;
+};
+
+struct TreeSnapshotExecutor
+{
+    uint64_t m_endElapsed;
+    uint64_t m_endDelay;
+    uint64_t m_tickInterval;
+    uint64_t m_lastTickElapsed;
+    uint32_t m_nodeCount;
+    uint32_t m_decoratorCount;
+    uint32_t m_subtreeCount;
+    uint32_t m_resumeAt;
+    uint8_t m_suspension;
+    uint8_t m_ticked;
+    uint8_t m_reserved[6];
+};
+
+struct TreeSnapshotNode
+{
+    uint32_t m_node;
+    int32_t m_decoStackSize;
+    int32_t m_ctr;
+    int32_t m_loop;
+    int32_t m_retry;
+};
+
+struct TreeSnapshotDecorator
+{
+    uint64_t m_elapsed;
+    uint64_t m_delay;
+    int32_t m_nodeStackIndex;
+    int32_t m_decoratorIndex;
+    uint32_t m_notified;
+    uint32_t m_reserved;
+};
+
+// Read-only memory mapping of a whole file.
+class TreeFileMapping
+{
+public:
+    // Throws if the file cannot be opened or is empty
+    TreeFileMapping(std::string const& path);
+    ~TreeFileMapping();
+    TreeFileMapping(TreeFileMapping const&) = delete;
+    TreeFileMapping& operator=(TreeFileMapping const&) = delete;
+    void const* Data() const;
+    size_t Size() const;
+private:
+    void const* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+//
+// Serializer
+//
+
+// Converts compiled trees to and from the binary format above. Callbacks
+// are stored by the name they were registered under in a CallbackRegistry,
+// so only trees built entirely from registered callbacks can be saved.
+template <typename C, typename LC, typename DC>
+class TreeSerializer
+{
+public:
+    static constexpr uint32_t MAGIC = 0x45525442; // "BTRE"
+    static constexpr uint32_t VERSION = 3;
+
+    static std::vector<uint8_t> Save(CompiledTree<C,LC,DC> const& tree);
+    static void SaveFile(std::string const& path, CompiledTree<C,LC,DC> const& tree);
+
+    // Validates "data" and resolves its callbacks from "registry". If "data"
+    // is 8 byte aligned the returned tree uses its node and child tables in
+    // place and holds on to "keepAlive", otherwise they are copied.
+    static std::shared_ptr<CompiledTree<C,LC,DC> const> Load(void const* data, size_t size, CallbackRegistry<C,LC,DC> const& registry, std::shared_ptr<void const> keepAlive = nullptr);
+    // Maps the file into memory and loads it without copying the tree
+    static std::shared_ptr<CompiledTree<C,LC,DC> const> LoadFile(std::string const& path, CallbackRegistry<C,LC,DC> const& registry);
+
+    static constexpr uint32_t SNAPSHOT_MAGIC = 0x58455442; // "BTEX"
+    static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+    // Encodes leaf and decorator memory in executor snapshots. Loaders
+    // return the number of bytes they read and throw if "size" is too
+    // small. Left empty, memory is copied bytewise, which requires it to be
+    // trivially copyable, and empty types are skipped.
+    struct MemoryCodec
+    {
+        std::function<void(LC const&, std::vector<uint8_t>&)> m_saveLeaf;
+        std::function<void(DC const&, std::vector<uint8_t>&)> m_saveDecorator;
+        std::function<size_t(uint8_t const*, size_t, LC&)> m_loadLeaf;
+        std::function<size_t(uint8_t const*, size_t, DC&)> m_loadDecorator;
+    };
+
+    // Saves where "executor" and its multiplexer subtrees are in their tree:
+    // stacks, loop and retry counters, leaf and decorator memory, pending
+    // events and timers relative to "now". Coroutine leaves are not saved
+    // and restart, like in copied executors. Typed leaf and decorator
+    // memory is not saved either, and is default constructed on load.
+    static std::vector<uint8_t> SaveExecutor(TreeExecutor<C,LC,DC> const& executor, uint64_t now, MemoryCodec const& codec = {});
+    // Restores a snapshot into "executor", which must run the tree it was
+    // saved from. Timers keep the time they had left at "now", and no
+    // callback or decorator is called until the next Update.
+    static void LoadExecutor(TreeExecutor<C,LC,DC>& executor, void const* data, size_t size, uint64_t now, MemoryCodec const& codec = {});
+private:
+    static void SaveExecutorState(TreeExecutor<C,LC,DC> const& executor, uint64_t now, MemoryCodec const& codec, std::vector<uint8_t>& out);
+    static void LoadExecutorState(TreeExecutor<C,LC,DC>& executor, uint8_t const*& data, uint8_t const* end, uint64_t now, MemoryCodec const& codec);
+};
+
+#include "BehaviorTreeSerialization.ipp"
@@ -0,0 +1,658 @@
+#pragma once
+
+#include "BehaviorTreeSerialization.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::is_trivially_copyable<CompiledNode>::value && sizeof(CompiledNode) == 40, "CompiledNode is part of the file format");
+static_assert(sizeof(TreeFileHeader) == 32, "TreeFileHeader is part of the file format");
+static_assert(sizeof(TreeFileSymbol) == 16, "TreeFileSymbol is part of the file format");
+static_assert(sizeof(TreeSnapshotHeader) == 16, "TreeSnapshotHeader is part of the snapshot format");
+static_assert(sizeof(TreeSnapshotExecutor) == 56, "TreeSnapshotExecutor is part of the snapshot format");
+static_assert(sizeof(TreeSnapshotNode) == 20, "TreeSnapshotNode is part of the snapshot format");
+static_assert(sizeof(TreeSnapshotDecorator) == 32, "TreeSnapshotDecorator is part of the snapshot format");
+
+inline bool BTIsLittleEndian()
+{
+    uint16_t value = 1;
+    uint8_t first;
+    std::memcpy(&first, &value, 1);
+    return first == 1;
+}
+
+inline size_t BTAlign8(size_t value)
+{
+    return (value + 7) & ~size_t(7);
+}
+
+// Restores a timer that had run for "elapsed" when it was saved. Time the
+// new clock cannot go back to is taken off the delay instead.
+inline TreeTimer BTRebaseTimer(uint64_t elapsed, uint64_t delay, uint64_t now)
+{
+    TreeTimer timer;
+    if (delay == UINT64_MAX)
+    {
+        timer.Disable();
+    }
+    else if (elapsed <= now)
+    {
+        timer.Set(now - elapsed, delay);
+    }
+    else
+    {
+        timer.Set(0, delay > elapsed - now ? delay - (elapsed - now) : 0);
+    }
+    return timer;
+}
+
+template <typename M>
+void BTSaveMemory(M const& memory, std::function<void(M const&, std::vector<uint8_t>&)> const& save, std::vector<uint8_t>& out)
+{
+    if (save)
+    {
+        save(memory, out);
+    }
+    else if constexpr (std::is_empty<M>::value)
+    {
+    }
+    else if constexpr (std::is_trivially_copyable<M>::value)
+    {
+        uint8_t const* bytes = reinterpret_cast<uint8_t const*>(&memory);
+        out.insert(out.end(), bytes, bytes + sizeof(M));
+    }
+    else
+    {
+        throw std::runtime_error("Saving executors with memory that is not trivially copyable requires a MemoryCodec");
+    }
+}
+
+template <typename M>
+void BTLoadMemory(M& memory, std::function<size_t(uint8_t const*, size_t, M&)> const& load, uint8_t const*& data, uint8_t const* end)
+{
+    if (load)
+    {
+        size_t read = load(data, size_t(end - data), memory);
+        if (read > size_t(end - data))
+        {
+            throw std::runtime_error("Executor snapshot is truncated");
+        }
+        data += read;
+    }
+    else if constexpr (std::is_empty<M>::value)
+    {
+    }
+    else if constexpr (std::is_trivially_copyable<M>::value)
+    {
+        if (size_t(end - data) < sizeof(M))
+        {
+            throw std::runtime_error("Executor snapshot is truncated");
+        }
+        std::memcpy(&memory, data, sizeof(M));
+        data += sizeof(M);
+    }
+    else
+    {
+        throw std::runtime_error("Loading executors with memory that is not trivially copyable requires a MemoryCodec");
+    }
+}
+
+template <typename T>
+void BTSnapshotWrite(T const& value, std::vector<uint8_t>& out)
+{
+    uint8_t const* bytes = reinterpret_cast<uint8_t const*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T BTSnapshotRead(uint8_t const*& data, uint8_t const* end)
+{
+    T value;
+    if (size_t(end - data) < sizeof(T))
+    {
+        throw std::runtime_error("Executor snapshot is truncated");
+    }
+    std::memcpy(&value, data, sizeof(T));
+    data += sizeof(T);
+    return value;
+}
+
+//
+// File Mapping
+//
+
+inline TreeFileMapping::TreeFileMapping(std::string const& path)
+{
+#ifdef _WIN32
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        m_file = nullptr;
+        throw std::runtime_error("Could not open " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(m_file);
+        throw std::runtime_error("Could not map " + path);
+    }
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!m_data)
+    {
+        if (m_mapping)
+        {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+        throw std::runtime_error("Could not map " + path);
+    }
+    m_size = size_t(size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Could not map " + path);
+    }
+    void* data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after closing the descriptor
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("Could not map " + path);
+    }
+    m_data = data;
+    m_size = size_t(info.st_size);
+#endif
+}
+
+inline TreeFileMapping::~TreeFileMapping()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+#else
+    munmap(const_cast<void*>(m_data), m_size);
+#endif
+}
+
+inline void const* TreeFileMapping::Data() const
+{
+    return m_data;
+}
+
+inline size_t TreeFileMapping::Size() const
+{
+    return m_size;
+}
+
+//
+// Serializer
+//
+
+template <typename C, typename LC, typename DC>
+std::vector<uint8_t> TreeSerializer<C,LC,DC>::Save(CompiledTree<C,LC,DC> const& tree)
+{
+    if (!BTIsLittleEndian())
+    {
+        throw std::runtime_error("Tree serialization requires a little endian host");
+    }
+
+    std::string strings;
+    std::vector<double> args;
+    auto writeSymbols = [&](std::vector<CallbackSymbol> const& symbols) {
+        std::vector<TreeFileSymbol> out;
+        for (CallbackSymbol const& symbol : symbols)
+        {
+            if (!symbol.IsNamed())
+            {
+                throw std::runtime_error("Cannot serialize a tree using unregistered callbacks");
+            }
+            out.push_back({ uint32_t(strings.size()), uint32_t(symbol.m_name.size()), uint32_t(args.size()), uint32_t(symbol.m_args.size()) });
+            strings += symbol.m_name;
+            args.insert(args.end(), symbol.m_args.begin(), symbol.m_args.end());
+        }
+        return out;
+    };
+    std::vector<TreeFileSymbol> callbacks = writeSymbols(tree.m_callbackSymbols);
+    std::vector<TreeFileSymbol> decorators = writeSymbols(tree.m_decoratorSymbols);
+    std::vector<TreeFileSymbol> events;
+    for (CallbackSymbol const& symbol : tree.m_decoratorSymbols)
+    {
+        events.push_back({ uint32_t(strings.size()), uint32_t(symbol.m_event.size()), 0, 0 });
+        strings += symbol.m_event;
+    }
+
+    size_t childCount = 0;
+    for (size_t i = 0; i < tree.m_nodeCount; ++i)
+    {
+        childCount = std::max<size_t>(childCount, tree.m_nodes[i].m_childEnd);
+    }
+
+    TreeFileHeader header = {
+        MAGIC,
+        VERSION,
+        uint32_t(tree.m_nodeCount),
+        uint32_t(childCount),
+        uint32_t(callbacks.size()),
+        uint32_t(decorators.size()),
+        uint32_t(strings.size()),
+        uint32_t(args.size())
+    };
+
+    std::vector<uint8_t> out;
+    auto write = [&](void const* data, size_t size) {
+        out.resize(BTAlign8(out.size()), 0);
+        out.insert(out.end(), static_cast<uint8_t const*>(data), static_cast<uint8_t const*>(data) + size);
+    };
+    write(&header, sizeof(header));
+    write(tree.m_nodes, sizeof(CompiledNode) * tree.m_nodeCount);
+    write(tree.m_children, sizeof(uint32_t) * childCount);
+    write(callbacks.data(), sizeof(TreeFileSymbol) * callbacks.size());
+    write(decorators.data(), sizeof(TreeFileSymbol) * decorators.size());
+    write(events.data(), sizeof(TreeFileSymbol) * events.size());
+    write(args.data(), sizeof(double) * args.size());
+    write(strings.data(), strings.size());
+    return out;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeSerializer<C,LC,DC>::SaveFile(std::string const& path, CompiledTree<C,LC,DC> const& tree)
+{
+    std::vector<uint8_t> data = Save(tree);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<char const*>(data.data()), data.size());
+    if (!file)
+    {
+        throw std::runtime_error("Could not write " + path);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+std::shared_ptr<CompiledTree<C,LC,DC> const> TreeSerializer<C,LC,DC>::Load(void const* data, size_t size, CallbackRegistry<C,LC,DC> const& registry, std::shared_ptr<void const> keepAlive)
+{
+    if (!BTIsLittleEndian())
+    {
+        throw std::runtime_error("Tree serialization requires a little endian host");
+    }
+
+    uint8_t const* bytes = static_cast<uint8_t const*>(data);
+    TreeFileHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("Tree file is truncated");
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if (header.m_magic != MAGIC)
+    {
+        throw std::runtime_error("Not a tree file");
+    }
+    // version 2 files only lack the event table
+    if (header.m_version != VERSION && header.m_version != 2)
+    {
+        throw std::runtime_error("Unsupported tree file version " + std::to_string(header.m_version));
+    }
+    if (header.m_nodeCount == 0)
+    {
+        throw std::runtime_error("Tree file has no nodes");
+    }
+
+    size_t nodeOffset = BTAlign8(sizeof(header));
+    size_t childOffset = BTAlign8(nodeOffset + sizeof(CompiledNode) * size_t(header.m_nodeCount));
+    size_t callbackOffset = BTAlign8(childOffset + sizeof(uint32_t) * size_t(header.m_childCount));
+    size_t decoratorOffset = BTAlign8(callbackOffset + sizeof(TreeFileSymbol) * size_t(header.m_callbackCount));
+    size_t eventOffset = BTAlign8(decoratorOffset + sizeof(TreeFileSymbol) * size_t(header.m_decoratorCount));
+    size_t eventCount = header.m_version >= 3 ? size_t(header.m_decoratorCount) : 0;
+    size_t argOffset = BTAlign8(eventOffset + sizeof(TreeFileSymbol) * eventCount);
+    size_t stringOffset = BTAlign8(argOffset + sizeof(double) * size_t(header.m_argCount));
+    if (stringOffset + header.m_stringBytes > size)
+    {
+        throw std::runtime_error("Tree file is truncated");
+    }
+
+    std::shared_ptr<CompiledTree<C,LC,DC>> tree(new CompiledTree<C,LC,DC>());
+    CompiledNode const* nodes;
+    uint32_t const* children;
+    if (reinterpret_cast<uintptr_t>(bytes) % 8 == 0)
+    {
+        nodes = reinterpret_cast<CompiledNode const*>(bytes + nodeOffset);
+        children = reinterpret_cast<uint32_t const*>(bytes + childOffset);
+        tree->m_mapping = keepAlive;
+    }
+    else
+    {
+        tree->m_nodeStorage.resize(header.m_nodeCount);
+        tree->m_childStorage.resize(header.m_childCount);
+        std::memcpy(tree->m_nodeStorage.data(), bytes + nodeOffset, sizeof(CompiledNode) * header.m_nodeCount);
+        std::memcpy(tree->m_childStorage.data(), bytes + childOffset, sizeof(uint32_t) * header.m_childCount);
+        nodes = tree->m_nodeStorage.data();
+        children = tree->m_childStorage.data();
+    }
+
+    for (uint32_t i = 0; i < header.m_nodeCount; ++i)
+    {
+        CompiledNode const& node = nodes[i];
+        bool valid = node.m_childBegin <= node.m_childEnd && node.m_childEnd <= header.m_childCount
+            && node.m_decoratorBegin <= node.m_decoratorEnd && node.m_decoratorEnd <= header.m_decoratorCount;
+        switch (node.m_kind)
+        {
+        case NodeKind::LEAF:
+            valid = valid && node.m_callback < header.m_callbackCount && node.m_childBegin == node.m_childEnd;
+            break;
+        case NodeKind::MULTIPLEXER:
+            valid = valid && (node.m_callback == CompiledNode::NO_CALLBACK || node.m_callback < header.m_callbackCount);
+            break;
+        case NodeKind::SEQUENCE:
+        case NodeKind::SELECTOR:
+            valid = valid && node.m_callback == CompiledNode::NO_CALLBACK;
+            break;
+        default:
+            valid = false;
+        }
+        if (!valid)
+        {
+            throw std::runtime_error("Tree file has an invalid node at index " + std::to_string(i));
+        }
+    }
+    for (uint32_t i = 0; i < header.m_childCount; ++i)
+    {
+        if (children[i] >= header.m_nodeCount)
+        {
+            throw std::runtime_error("Tree file has an invalid child index");
+        }
+    }
+
+    char const* strings = reinterpret_cast<char const*>(bytes + stringOffset);
+    auto readSymbol = [&](size_t offset, bool optional) {
+        TreeFileSymbol symbol;
+        std::memcpy(&symbol, bytes + offset, sizeof(symbol));
+        if ((symbol.m_length == 0 && !optional) || size_t(symbol.m_offset) + symbol.m_length > header.m_stringBytes
+            || size_t(symbol.m_argBegin) + symbol.m_argCount > header.m_argCount)
+        {
+            throw std::runtime_error("Tree file has an invalid symbol");
+        }
+        CallbackArgs args(symbol.m_argCount);
+        if (symbol.m_argCount > 0)
+        {
+            std::memcpy(args.data(), bytes + argOffset + sizeof(double) * symbol.m_argBegin, sizeof(double) * symbol.m_argCount);
+        }
+        return CallbackSymbol{ std::string(strings + symbol.m_offset, symbol.m_length), std::move(args) };
+    };
+    for (uint32_t i = 0; i < header.m_callbackCount; ++i)
+    {
+        CallbackSymbol symbol = readSymbol(callbackOffset + i * sizeof(TreeFileSymbol), false);
+        symbol.m_perTick = registry.IsLeafPerTick(symbol.m_name);
+        tree->m_callbacks.push_back(registry.GetLeaf(symbol.m_name, symbol.m_args));
+        if (auto batch = registry.GetBatchLeaf(symbol.m_name))
+        {
+            tree->m_batchCallbacks.resize(tree->m_callbacks.size());
+            tree->m_batchCallbacks.back() = std::move(batch);
+        }
+        tree->m_callbackSymbols.push_back(std::move(symbol));
+    }
+    for (uint32_t i = 0; i < header.m_decoratorCount; ++i)
+    {
+        CallbackSymbol symbol = readSymbol(decoratorOffset + i * sizeof(TreeFileSymbol), false);
+        if (eventCount > 0)
+        {
+            symbol.m_event = readSymbol(eventOffset + i * sizeof(TreeFileSymbol), true).m_name;
+        }
+        symbol.m_perTick = registry.IsDecoratorPerTick(symbol.m_name);
+        tree->m_decorators.push_back(registry.GetDecorator(symbol.m_name, symbol.m_args));
+        tree->m_decoratorEvents.push_back(symbol.m_event.empty() ? NO_TREE_EVENT : registry.GetEvent(symbol.m_event));
+        tree->m_decoratorSymbols.push_back(std::move(symbol));
+    }
+
+    tree->Finalize(nodes, header.m_nodeCount, children);
+    return tree;
+}
+
+template <typename C, typename LC, typename DC>
+std::shared_ptr<CompiledTree<C,LC,DC> const> TreeSerializer<C,LC,DC>::LoadFile(std::string const& path, CallbackRegistry<C,LC,DC> const& registry)
+{
+    std::shared_ptr<TreeFileMapping> mapping = std::make_shared<TreeFileMapping>(path);
+    return Load(mapping->Data(), mapping->Size(), registry, mapping);
+}
+
+//
+// Executor Snapshots
+//
+
+template <typename C, typename LC, typename DC>
+std::vector<uint8_t> TreeSerializer<C,LC,DC>::SaveExecutor(TreeExecutor<C,LC,DC> const& executor, uint64_t now, MemoryCodec const& codec)
+{
+    if (!BTIsLittleEndian())
+    {
+        throw std::runtime_error("Executor snapshots require a little endian host");
+    }
+    TreeSnapshotHeader header = {
+        SNAPSHOT_MAGIC,
+        SNAPSHOT_VERSION,
+        executor.m_tree ? uint32_t(executor.m_tree->NodeCount()) : 0,
+        executor.m_root
+    };
+    std::vector<uint8_t> out;
+    BTSnapshotWrite(header, out);
+    SaveExecutorState(executor, now, codec, out);
+    return out;
+}
+
+template <typename C, typename LC, typename DC>
+void TreeSerializer<C,LC,DC>::SaveExecutorState(TreeExecutor<C,LC,DC> const& executor, uint64_t now, MemoryCodec const& codec, std::vector<uint8_t>& out)
+{
+    auto elapsed = [&](uint64_t start) { return now > start ? now - start : 0; };
+    TreeSnapshotExecutor state = {};
+    state.m_endElapsed = elapsed(executor.m_endTimer.m_start);
+    state.m_endDelay = executor.m_endTimer.m_delay;
+    state.m_tickInterval = executor.m_tickInterval;
+    state.m_lastTickElapsed = elapsed(executor.m_lastTick);
+    state.m_nodeCount = uint32_t(executor.m_nodeStack.size());
+    state.m_decoratorCount = uint32_t(executor.m_decoratorStack.size());
+    state.m_subtreeCount = uint32_t(executor.m_activeSubtrees);
+    state.m_resumeAt = executor.m_resumeAt;
+    state.m_suspension = uint8_t(executor.m_suspension);
+    state.m_ticked = executor.m_ticked;
+    BTSnapshotWrite(state, out);
+
+    for (NodeStackEntry<C,LC,DC> const& entry : executor.m_nodeStack)
+    {
+        BTSnapshotWrite(TreeSnapshotNode{ entry.m_node, entry.m_decoStackSize, entry.m_ctr, entry.m_loop, entry.m_retry }, out);
+        BTSaveMemory(entry.m_memory, codec.m_saveLeaf, out);
+    }
+    for (DecoratorStackEntry<DC> const& entry : executor.m_decoratorStack)
+    {
+        BTSnapshotWrite(TreeSnapshotDecorator{
+            elapsed(entry.m_timer.m_start),
+            entry.m_timer.m_delay,
+            entry.m_nodeStackIndex,
+            entry.m_decoratorIndex,
+            entry.m_notified,
+            0
+        }, out);
+        BTSaveMemory(entry.m_memory, codec.m_saveDecorator, out);
+    }
+    for (size_t i = 0; i < executor.m_activeSubtrees; ++i)
+    {
+        SaveExecutorState(executor.m_subtrees[i], now, codec, out);
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeSerializer<C,LC,DC>::LoadExecutor(TreeExecutor<C,LC,DC>& executor, void const* data, size_t size, uint64_t now, MemoryCodec const& codec)
+{
+    if (!BTIsLittleEndian())
+    {
+        throw std::runtime_error("Executor snapshots require a little endian host");
+    }
+    uint8_t const* bytes = static_cast<uint8_t const*>(data);
+    uint8_t const* end = bytes + size;
+    TreeSnapshotHeader header = BTSnapshotRead<TreeSnapshotHeader>(bytes, end);
+    if (header.m_magic != SNAPSHOT_MAGIC)
+    {
+        throw std::runtime_error("Not an executor snapshot");
+    }
+    if (header.m_version != SNAPSHOT_VERSION)
+    {
+        throw std::runtime_error("Unsupported executor snapshot version " + std::to_string(header.m_version));
+    }
+    if (executor.m_tree == nullptr)
+    {
+        executor.m_treeRef = executor.m_ctx->Compile(executor.m_rootNode);
+        executor.m_tree = executor.m_treeRef.get();
+    }
+    // snapshots of executors that never ran have empty stacks
+    if (header.m_root != executor.m_root || (header.m_treeNodeCount != 0 && header.m_treeNodeCount != executor.m_tree->NodeCount()))
+    {
+        throw std::runtime_error("Executor snapshot was saved from another tree");
+    }
+    LoadExecutorState(executor, bytes, end, now, codec);
+    if (bytes != end)
+    {
+        throw std::runtime_error("Executor snapshot has trailing data");
+    }
+}
+
+template <typename C, typename LC, typename DC>
+void TreeSerializer<C,LC,DC>::LoadExecutorState(TreeExecutor<C,LC,DC>& executor, uint8_t const*& data, uint8_t const* end, uint64_t now, MemoryCodec const& codec)
+{
+    using Suspension = typename TreeExecutor<C,LC,DC>::Suspension;
+    CompiledTree<C,LC,DC> const& tree = *executor.m_tree;
+    executor.Reset(executor.m_tree, executor.m_root);
+
+    TreeSnapshotExecutor state = BTSnapshotRead<TreeSnapshotExecutor>(data, end);
+    if (state.m_suspension > uint8_t(Suspension::BATCH) || state.m_nodeCount > size_t(end - data) / sizeof(TreeSnapshotNode)
+        || state.m_decoratorCount > size_t(end - data) / sizeof(TreeSnapshotDecorator))
+    {
+        throw std::runtime_error("Executor snapshot is corrupt");
+    }
+    executor.m_endTimer = BTRebaseTimer(state.m_endElapsed, state.m_endDelay, now);
+    executor.m_tickInterval = state.m_tickInterval;
+    executor.m_lastTick = state.m_lastTickElapsed <= now ? now - state.m_lastTickElapsed : 0;
+    executor.m_ticked = state.m_ticked != 0;
+    executor.m_suspension = Suspension(state.m_suspension);
+    executor.m_resumeAt = state.m_resumeAt;
+
+    // every entry but the root must be the child its parent is at, so
+    // entries of another tree are rejected instead of being run
+    executor.m_nodeStack.reserve(state.m_nodeCount);
+    for (uint32_t i = 0; i < state.m_nodeCount; ++i)
+    {
+        TreeSnapshotNode node = BTSnapshotRead<TreeSnapshotNode>(data, end);
+        bool valid = node.m_node < tree.NodeCount() && node.m_decoStackSize >= 0 && uint32_t(node.m_decoStackSize) <= state.m_decoratorCount;
+        if (valid && i == 0)
+        {
+            valid = node.m_node == executor.m_root;
+        }
+        else if (valid)
+        {
+            NodeStackEntry<C,LC,DC> const& parent = executor.m_nodeStack.back();
+            CompiledNode const& parentNode = tree.m_nodes[parent.m_node];
+            valid = (parentNode.m_kind == NodeKind::SEQUENCE || parentNode.m_kind == NodeKind::SELECTOR)
+                && parent.m_ctr >= 0 && uint32_t(parent.m_ctr) < parentNode.m_childEnd - parentNode.m_childBegin
+                && tree.m_children[parentNode.m_childBegin + parent.m_ctr] == node.m_node
+                && parent.m_decoStackSize <= node.m_decoStackSize;
+        }
+        if (!valid)
+        {
+            throw std::runtime_error("Executor snapshot is corrupt");
+        }
+        executor.m_nodeStack.push_back({ node.m_node, LC(), node.m_decoStackSize, node.m_ctr, node.m_loop, node.m_retry });
+        BTLoadMemory(executor.m_nodeStack.back().m_memory, codec.m_loadLeaf, data, end);
+    }
+
+    executor.m_decoratorStack.reserve(state.m_decoratorCount);
+    for (uint32_t i = 0; i < state.m_decoratorCount; ++i)
+    {
+        TreeSnapshotDecorator decorator = BTSnapshotRead<TreeSnapshotDecorator>(data, end);
+        // decorators are pushed with the entries they decorate
+        int previous = i > 0 ? executor.m_decoratorStack.back().m_nodeStackIndex : 0;
+        if (decorator.m_nodeStackIndex < previous || uint32_t(decorator.m_nodeStackIndex) >= state.m_nodeCount || decorator.m_decoratorIndex < 0)
+        {
+            throw std::runtime_error("Executor snapshot is corrupt");
+        }
+        CompiledNode const& decorated = tree.m_nodes[executor.m_nodeStack[decorator.m_nodeStackIndex].m_node];
+        if (uint32_t(decorator.m_decoratorIndex) >= decorated.m_decoratorEnd - decorated.m_decoratorBegin)
+        {
+            throw std::runtime_error("Executor snapshot is corrupt");
+        }
+        executor.m_decoratorStack.push_back({ DC(), decorator.m_nodeStackIndex, decorator.m_decoratorIndex, BTRebaseTimer(decorator.m_elapsed, decorator.m_delay, now), decorator.m_notified != 0 });
+        BTLoadMemory(executor.m_decoratorStack.back().m_memory, codec.m_loadDecorator, data, end);
+    }
+
+    // typed memory is not saved, it is constructed again in stack order
+    size_t decorator = 0;
+    for (NodeStackEntry<C,LC,DC>& entry : executor.m_nodeStack)
+    {
+        CompiledNode const& node = tree.m_nodes[entry.m_node];
+        int index = int(&entry - executor.m_nodeStack.begin());
+        for (; decorator < executor.m_decoratorStack.size() && executor.m_decoratorStack[decorator].m_nodeStackIndex == index; ++decorator)
+        {
+            DecoratorStackEntry<DC>& decoratorEntry = executor.m_decoratorStack[decorator];
+            if (TreeMemoryType const* memory = tree.m_typedDecorators[node.m_decoratorBegin + decoratorEntry.m_decoratorIndex].m_memory)
+            {
+                decoratorEntry.m_slabOffset = executor.m_slab.Push(*memory);
+            }
+        }
+        if (node.m_kind == NodeKind::LEAF && tree.m_typedCallbacks[node.m_callback].m_memory)
+        {
+            entry.m_slabOffset = executor.m_slab.Push(*tree.m_typedCallbacks[node.m_callback].m_memory);
+        }
+        // rebuilds truncate the decorator stack to this size
+        if (size_t(entry.m_decoStackSize) != decorator)
+        {
+            throw std::runtime_error("Executor snapshot is corrupt");
+        }
+        entry.m_slabMark = uint32_t(executor.m_slab.Mark());
+    }
+    if (decorator != executor.m_decoratorStack.size())
+    {
+        throw std::runtime_error("Executor snapshot is corrupt");
+    }
+
+    bool resumable = executor.m_suspension == Suspension::NONE
+        || (executor.m_suspension == Suspension::ADD_CHILD && executor.m_resumeAt < tree.NodeCount())
+        || (executor.m_suspension == Suspension::SUBTREES && executor.m_resumeAt < state.m_subtreeCount)
+        // the leaf is called on its own when the executor is next updated
+        || (executor.m_suspension == Suspension::BATCH && state.m_nodeCount > 0 && tree.m_nodes[executor.m_nodeStack.back().m_node].m_kind == NodeKind::LEAF);
+    if (!resumable)
+    {
+        throw std::runtime_error("Executor snapshot is corrupt");
+    }
+    if (state.m_subtreeCount > 0)
+    {
+        CompiledNode const* multiplexer = state.m_nodeCount > 0 ? &tree.m_nodes[executor.m_nodeStack.back().m_node] : nullptr;
+        if (multiplexer == nullptr || multiplexer->m_kind != NodeKind::MULTIPLEXER || state.m_subtreeCount != multiplexer->m_childEnd - multiplexer->m_childBegin)
+        {
+            throw std::runtime_error("Executor snapshot is corrupt");
+        }
+        executor.EnterSubtrees(*multiplexer);
+        for (uint32_t i = 0; i < state.m_subtreeCount; ++i)
+        {
+            LoadExecutorState(executor.m_subtrees[i], data, end, now, codec);
+        }
+    }
+}
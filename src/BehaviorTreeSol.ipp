@@ -4,11 +4,64 @@
 
 #include <sol/sol.hpp>
 
+#include <functional>
+#include <stdexcept>
+
+// Arguments of registered callbacks are passed from lua as arrays of numbers
+inline CallbackArgs LuaCallbackArgs(sol::table const& table)
+{
+    CallbackArgs args;
+    for (size_t i = 1; i <= table.size(); ++i)
+    {
+        args.push_back(table[i].get<double>());
+    }
+    return args;
+}
+
+// Batched leaves are called with an array of contexts and one of memories,
+// one entry per executor in the batch, and return an array of results. This
+// crosses into lua once per batch instead of once per executor.
+template <typename C, typename LC>
+BatchLeafCallback<C,LC> LuaBatchLeafCallback(sol::protected_function callback)
+{
+    return [=](size_t count, std::remove_reference_t<C>* const* contexts, LC* const* memories, int* results) {
+        sol::state_view lua(callback.lua_state());
+        sol::table contextTable = lua.create_table(int(count), 0);
+        sol::table memoryTable = lua.create_table(int(count), 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            // passed like the arguments of unbatched leaves
+            contextTable[i + 1] = std::ref(*contexts[i]);
+            memoryTable[i + 1] = std::ref(*memories[i]);
+        }
+        sol::protected_function_result result = callback(contextTable, memoryTable);
+        if (!result.valid())
+        {
+            sol::error error = result;
+            throw std::runtime_error(error.what());
+        }
+        sol::table resultTable = result;
+        for (size_t i = 0; i < count; ++i)
+        {
+            results[i] = resultTable[i + 1].get<int>();
+        }
+    };
+}
+
 template <typename C, typename LC, typename DC, typename T>
 void LuaRegisterDecorableNode(std::string const& name, sol::state & state)
 {
     sol::usertype<DecorableNode<C,LC,DC,T>> node = state.new_usertype<DecorableNode<C, LC, DC,T>>(name + "DecorableNode", sol::base_classes, sol::bases<Node<C, LC, DC>>());
     node.set_function("Decorate", sol::overload(
+        // registered callbacks run natively, without calling back into lua
+        [](DecorableNode<C, LC, DC,T>& node, std::string const& name)
+        {
+            node.Decorate(name);
+        },
+        [](DecorableNode<C, LC, DC,T>& node, std::string const& name, sol::table args)
+        {
+            node.Decorate(name, LuaCallbackArgs(args));
+        },
         [](DecorableNode<C, LC, DC,T>& node, sol::protected_function callback)
         {
             node.Decorate([=](C& ctx, DC& dc) { return callback(ctx, dc); });
@@ -17,10 +70,26 @@ void LuaRegisterDecorableNode(std::string const& name, sol::state & state)
         {
             for (auto const& [key, value] : table)
             {
-                node.Decorate([=](C& ctx, DC& dc) { return value.as<sol::protected_function>()(ctx, dc); });
+                // convert once here, not on every evaluation
+                sol::protected_function callback = value.template as<sol::protected_function>();
+                node.Decorate([=](C& ctx, DC& dc) { return callback(ctx, dc); });
             }
         }
     ));
+    node.set_function("DecorateOn", sol::overload(
+        [](DecorableNode<C, LC, DC,T>& node, std::string const& event, std::string const& name)
+        {
+            node.DecorateOn(event, name);
+        },
+        [](DecorableNode<C, LC, DC,T>& node, std::string const& event, std::string const& name, sol::table args)
+        {
+            node.DecorateOn(event, name, LuaCallbackArgs(args));
+        },
+        [](DecorableNode<C, LC, DC,T>& node, std::string const& event, sol::protected_function callback)
+        {
+            node.DecorateOn(event, [=](C& ctx, DC& dc) { return callback(ctx, dc); });
+        }
+    ));
 }
 
 template <typename C, typename LC, typename DC, typename T>
@@ -47,6 +116,18 @@ void LuaRegisterBranchNode(std::string const& name, sol::state& state)
     );
 
     node.set_function("AddLeaf", sol::overload(
+        [](BranchNode<C, LC, DC, T>* self, std::string const& name) {
+            return self->AddLeaf(name);
+        },
+        [](BranchNode<C, LC, DC, T>* self, std::string const& name, sol::table args) {
+            return self->AddLeaf(name, LuaCallbackArgs(args));
+        },
+        [](BranchNode<C, LC, DC, T>* self, std::string const& name, sol::function callback) {
+            return self->AddLeaf(name, [=](Leaf<C, LC, DC>* node) { callback(node); });
+        },
+        [](BranchNode<C, LC, DC, T>* self, std::string const& name, sol::table args, sol::function callback) {
+            return self->AddLeaf(name, LuaCallbackArgs(args), [=](Leaf<C, LC, DC>* node) { callback(node); });
+        },
         [](BranchNode<C, LC, DC, T>* self, sol::function exec) {
             return self->AddLeaf([=](C& ctx, LC& lc) { return exec(ctx, lc); });
         },
@@ -58,7 +139,26 @@ void LuaRegisterBranchNode(std::string const& name, sol::state& state)
         }
     ));
 
+    // batch leaves registered by name are added with AddLeaf
+    node.set_function("AddBatchLeaf", sol::overload(
+        [](BranchNode<C, LC, DC, T>* self, sol::protected_function exec) {
+            return self->AddBatchLeaf(LuaBatchLeafCallback<C, LC>(exec));
+        },
+        [](BranchNode<C, LC, DC, T>* self, sol::protected_function exec, sol::function callback) {
+            return self->AddBatchLeaf(
+                LuaBatchLeafCallback<C, LC>(exec),
+                [=](Leaf<C, LC, DC>* node) { callback(node); }
+            );
+        }
+    ));
+
     node.set_function("AddMultiplexer", sol::overload(
+        [](BranchNode<C, LC, DC, T>* self, std::string const& name, sol::function callback) {
+            return self->AddMultiplexer(name, [=](Multiplexer<C, LC, DC>* node) { callback(node); });
+        },
+        [](BranchNode<C, LC, DC, T>* self, std::string const& name, sol::table args, sol::function callback) {
+            return self->AddMultiplexer(name, LuaCallbackArgs(args), [=](Multiplexer<C, LC, DC>* node) { callback(node); });
+        },
         [](BranchNode<C, LC, DC, T>* self, sol::function callback) {
             return self->AddMultiplexer(
                 [=](Multiplexer<C, LC, DC>* node) { callback(node); }
@@ -106,6 +206,9 @@ void LuaRegisterBehaviorTree(sol::state & state, std::string const& nameBase, Be
 
     sol::usertype<BehaviorTreeContext<C, LC, DC>> context = state.new_usertype<BehaviorTreeContext<C, LC, DC>>(nameBase+"BehaviorTreeContext");
     context.set_function("CreateSequence", &BehaviorTreeContext<C,LC,DC>::CreateSequence);
+    context.set_function("BeginTreeArena", [](BehaviorTreeContext<C, LC, DC>* ctx) { return ctx->BeginTreeArena(); });
+    context.set_function("EndTreeArena", &BehaviorTreeContext<C,LC,DC>::EndTreeArena);
+    context.set_function("ReleaseTreeArena", &BehaviorTreeContext<C,LC,DC>::ReleaseTreeArena);
     context.set_function("CreateSelector", &BehaviorTreeContext<C,LC,DC>::CreateSelector);
     auto createLeaf =
         [](BehaviorTreeContext<C, LC, DC>* ctx, sol::protected_function func)
@@ -114,6 +217,28 @@ void LuaRegisterBehaviorTree(sol::state & state, std::string const& nameBase, Be
                 return func(ctx, lc);
             });
         };
+    auto createBatchLeaf =
+        [](BehaviorTreeContext<C, LC, DC>* ctx, sol::protected_function func)
+        {
+            return ctx->CreateBatchLeaf(LuaBatchLeafCallback<C, LC>(func));
+        };
+    // unlike leaves from CreateBatchLeaf, leaves using a registered batch
+    // leaf can be serialized and keep their state across ReplaceTree
+    auto registerBatchLeaf =
+        [](BehaviorTreeContext<C, LC, DC>* ctx, std::string const& name, sol::protected_function func)
+        {
+            ctx->Callbacks().RegisterBatchLeaf(name, LuaBatchLeafCallback<C, LC>(func));
+        };
+    auto createNamedLeaf =
+        [](BehaviorTreeContext<C, LC, DC>* ctx, std::string const& name, sol::optional<sol::table> args)
+        {
+            return ctx->CreateLeaf(name, args ? LuaCallbackArgs(*args) : CallbackArgs());
+        };
+    auto createNamedMultiplexer =
+        [](BehaviorTreeContext<C, LC, DC>* ctx, std::string const& name, sol::optional<sol::table> args)
+        {
+            return ctx->CreateMultiplexer(name, args ? LuaCallbackArgs(*args) : CallbackArgs());
+        };
     auto createMultiplexerA =
         [](BehaviorTreeContext<C, LC, DC>* ctx, sol::protected_function func)
         {
@@ -128,17 +253,26 @@ void LuaRegisterBehaviorTree(sol::state & state, std::string const& nameBase, Be
         }
     ;
 
-    context.set_function("CreateLeaf",createLeaf);
-    context.set_function("CreateMultiplexer", sol::overload(createMultiplexerA,createMultiplexerB));
+    context.set_function("CreateLeaf", sol::overload(createNamedLeaf,createLeaf));
+    context.set_function("CreateBatchLeaf", createBatchLeaf);
+    context.set_function("RegisterBatchLeaf", registerBatchLeaf);
+    context.set_function("CreateMultiplexer", sol::overload(createNamedMultiplexer,createMultiplexerA,createMultiplexerB));
     if (globalCtx)
     {
         state.set_function(globalCtxPrefix + "Create " + globalCtxInfix + "Sequence" + globalCtxSuffix,
             [=]() { return globalCtx->CreateSequence(); });
         state.set_function(globalCtxPrefix + "Create" + globalCtxInfix + "Selector" + globalCtxSuffix,
             [=]() { return globalCtx->CreateSelector(); });
-        state.set_function(globalCtxPrefix + "Create" + globalCtxInfix + "Leaf" + globalCtxSuffix,
-            [=](sol::protected_function func) { return createLeaf(globalCtx,func); });
+        state.set_function(globalCtxPrefix + "Create" + globalCtxInfix + "Leaf" + globalCtxSuffix, sol::overload(
+            [=](std::string const& name, sol::optional<sol::table> args) { return createNamedLeaf(globalCtx,name,args); },
+            [=](sol::protected_function func) { return createLeaf(globalCtx,func); }
+        ));
+        state.set_function(globalCtxPrefix + "Create" + globalCtxInfix + "BatchLeaf" + globalCtxSuffix,
+            [=](sol::protected_function func) { return createBatchLeaf(globalCtx,func); });
+        state.set_function(globalCtxPrefix + "Register" + globalCtxInfix + "BatchLeaf" + globalCtxSuffix,
+            [=](std::string const& name, sol::protected_function func) { registerBatchLeaf(globalCtx,name,func); });
         state.set_function(globalCtxPrefix + "Create"  + globalCtxInfix + "Multiplexer" + globalCtxSuffix, sol::overload(
+            [=](std::string const& name, sol::optional<sol::table> args) { return createNamedMultiplexer(globalCtx,name,args); },
             [=](sol::protected_function callback) { return createMultiplexerA(globalCtx,callback); },
             [=]() { return createMultiplexerB(globalCtx); }
         ));
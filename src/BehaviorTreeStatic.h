@@ -0,0 +1,157 @@
+#pragma once
+
+#include "BehaviorTree.h"
+
+#include <array>
+#include <tuple>
+#include <utility>
+
+//
+// Static Trees
+//
+
+// Trees fixed at compile time, composed from the node types below:
+//
+//   using Boss = StaticSelector<
+//       StaticDecorated<StaticLeaf<&Flee>, &HealthLow>,
+//       StaticSequence<StaticLeaf<&Approach>, StaticLeaf<&Attack>>
+//   >;
+//   StaticTreeExecutor<Boss, Agent> executor;
+//
+// Callbacks are plain functions with the signatures of LeafCallback and
+// DecoratorCallback. They are called directly instead of through
+// std::function, so they can be inlined. An executor holds the state of
+// every node inline, has a fixed size and never allocates, and behaves
+// exactly like a TreeExecutor running the equivalent dynamic tree.
+
+template <auto Callback>
+struct StaticLeaf {};
+
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children>
+struct StaticBranch {};
+
+template <typename... Children>
+using StaticSequence = StaticBranch<BranchType::SEQUENCE, 1, 1, Children...>;
+
+template <typename... Children>
+using StaticSelector = StaticBranch<BranchType::SELECTOR, 1, 1, Children...>;
+
+// Callback may be nullptr, the multiplexer then runs until interrupted
+template <auto Callback, typename... Children>
+struct StaticMultiplexer {};
+
+template <typename Decorated, auto... Decorators>
+struct StaticDecorated {};
+
+// Implementation of a node type. Enter starts the node and Resume continues
+// it, both return SUCCESS or FAILURE once the node is done and INSTANT
+// while it keeps running.
+template <typename N, typename C, typename LC, typename DC>
+struct StaticNode;
+
+template <auto Callback, typename C, typename LC, typename DC>
+struct StaticNode<StaticLeaf<Callback>,C,LC,DC>
+{
+    struct State
+    {
+        LC m_memory;
+        TreeTimer m_timer;
+    };
+    static int Enter(State& state, C& ctx, uint64_t now);
+    static int Resume(State& state, C& ctx, uint64_t now);
+    static int Execute(State& state, C& ctx, uint64_t now);
+};
+
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children, typename C, typename LC, typename DC>
+struct StaticNode<StaticBranch<Type,Loops,Attempts,Children...>,C,LC,DC>
+{
+    template <size_t I>
+    using Child = StaticNode<std::tuple_element_t<I, std::tuple<Children...>>,C,LC,DC>;
+    using Indices = std::index_sequence_for<Children...>;
+
+    struct State
+    {
+        uint32_t m_ctr = 0;
+        uint64_t m_loop = 0;
+        uint64_t m_retry = 0;
+        std::tuple<typename StaticNode<Children,C,LC,DC>::State...> m_children;
+    };
+    static int Enter(State& state, C& ctx, uint64_t now);
+    static int Resume(State& state, C& ctx, uint64_t now);
+    static int Traverse(State& state, C& ctx, uint64_t now, TraversalMode mode);
+    // the child at state.m_ctr, dispatched without any indirection
+    template <size_t... I>
+    static int EnterChild(State& state, C& ctx, uint64_t now, std::index_sequence<I...>);
+    template <size_t... I>
+    static int ResumeChild(State& state, C& ctx, uint64_t now, std::index_sequence<I...>);
+};
+
+template <auto Callback, typename... Children, typename C, typename LC, typename DC>
+struct StaticNode<StaticMultiplexer<Callback,Children...>,C,LC,DC>
+{
+    template <size_t I>
+    using Child = StaticNode<std::tuple_element_t<I, std::tuple<Children...>>,C,LC,DC>;
+    using Indices = std::index_sequence_for<Children...>;
+
+    struct State
+    {
+        LC m_memory;
+        TreeTimer m_timer;
+        std::tuple<typename StaticNode<Children,C,LC,DC>::State...> m_children;
+        // subtrees restart once they are done, like those of a TreeExecutor
+        std::array<bool, sizeof...(Children)> m_running = {};
+    };
+    static int Enter(State& state, C& ctx, uint64_t now);
+    static int Resume(State& state, C& ctx, uint64_t now);
+    static int Execute(State& state, C& ctx, uint64_t now);
+    template <size_t I>
+    static void UpdateSubtree(State& state, C& ctx, uint64_t now);
+    template <size_t... I>
+    static void UpdateSubtrees(State& state, C& ctx, uint64_t now, std::index_sequence<I...>);
+};
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+struct StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>
+{
+    using Node = StaticNode<Decorated,C,LC,DC>;
+    using Indices = std::index_sequence_for<decltype(Decorators)...>;
+
+    struct State
+    {
+        typename Node::State m_node;
+        std::array<DC, sizeof...(Decorators)> m_memory;
+        std::array<TreeTimer, sizeof...(Decorators)> m_timers;
+        // decorators that returned a delay, the others are not evaluated again
+        std::array<bool, sizeof...(Decorators)> m_active = {};
+    };
+    static int Enter(State& state, C& ctx, uint64_t now);
+    static int Resume(State& state, C& ctx, uint64_t now);
+    // false if the decorator failed
+    template <size_t I, auto Decorator>
+    static bool EnterDecorator(State& state, C& ctx, uint64_t now);
+    template <size_t I, auto Decorator>
+    static bool ResumeDecorator(State& state, C& ctx, uint64_t now);
+    template <size_t... I>
+    static bool EnterDecorators(State& state, C& ctx, uint64_t now, std::index_sequence<I...>);
+    template <size_t... I>
+    static bool ResumeDecorators(State& state, C& ctx, uint64_t now, std::index_sequence<I...>);
+};
+
+//
+// Static Execution
+//
+
+template <typename Root, typename C = std::monostate, typename LC = std::monostate, typename DC = LC>
+class StaticTreeExecutor
+{
+public:
+    void Update(C& ctx, uint64_t now);
+    // False before the first Update and after the tree ended, in which case
+    // the next Update restarts it
+    bool IsRunning() const;
+private:
+    typename StaticNode<Root,C,LC,DC>::State m_state;
+    bool m_running = false;
+};
+
+#include "BehaviorTreeStatic.ipp"
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "BehaviorTreeStatic.h"
+
+#include <type_traits>
+
+//
+// Static Leaves
+//
+
+template <auto Callback, typename C, typename LC, typename DC>
+int StaticNode<StaticLeaf<Callback>,C,LC,DC>::Enter(State& state, C& ctx, uint64_t now)
+{
+    state.m_memory = LC();
+    state.m_timer.Clear();
+    return Execute(state, ctx, now);
+}
+
+template <auto Callback, typename C, typename LC, typename DC>
+int StaticNode<StaticLeaf<Callback>,C,LC,DC>::Resume(State& state, C& ctx, uint64_t now)
+{
+    if (!state.m_timer.HasPassed(now))
+    {
+        return Result::INSTANT;
+    }
+    return Execute(state, ctx, now);
+}
+
+template <auto Callback, typename C, typename LC, typename DC>
+int StaticNode<StaticLeaf<Callback>,C,LC,DC>::Execute(State& state, C& ctx, uint64_t now)
+{
+    int result = Callback(ctx, state.m_memory);
+    if (result == Result::SUCCESS || result == Result::FAILURE)
+    {
+        return result;
+    }
+    state.m_timer.Set(now, result);
+    return Result::INSTANT;
+}
+
+//
+// Static Branches
+//
+
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children, typename C, typename LC, typename DC>
+int StaticNode<StaticBranch<Type,Loops,Attempts,Children...>,C,LC,DC>::Enter(State& state, C& ctx, uint64_t now)
+{
+    state.m_ctr = 0;
+    state.m_loop = 0;
+    state.m_retry = 0;
+    return Traverse(state, ctx, now, TraversalMode::TRAVERSAL);
+}
+
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children, typename C, typename LC, typename DC>
+int StaticNode<StaticBranch<Type,Loops,Attempts,Children...>,C,LC,DC>::Resume(State& state, C& ctx, uint64_t now)
+{
+    int result = ResumeChild(state, ctx, now, Indices());
+    if (result == Result::INSTANT)
+    {
+        return result;
+    }
+    return Traverse(state, ctx, now, ResultToTraversal(Result(result)));
+}
+
+// Same transitions as the traverse block of TreeExecutor::Update
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children, typename C, typename LC, typename DC>
+int StaticNode<StaticBranch<Type,Loops,Attempts,Children...>,C,LC,DC>::Traverse(State& state, C& ctx, uint64_t now, TraversalMode mode)
+{
+    for (;;)
+    {
+        switch (mode)
+        {
+        case TraversalMode::SUCCESS:
+            if constexpr (Type == BranchType::SELECTOR)
+            {
+                state.m_loop++;
+                state.m_ctr = 0;
+            }
+            else
+            {
+                state.m_ctr++;
+            }
+            break;
+        case TraversalMode::FAILURE:
+            if constexpr (Type == BranchType::SELECTOR)
+            {
+                state.m_ctr++;
+            }
+            else
+            {
+                state.m_retry++;
+                state.m_ctr = 0;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if (state.m_ctr >= sizeof...(Children))
+        {
+            if constexpr (Type == BranchType::SELECTOR)
+            {
+                state.m_retry++;
+            }
+            else
+            {
+                state.m_loop++;
+            }
+            state.m_ctr = 0;
+        }
+
+        if (state.m_retry >= Attempts)
+        {
+            return Result::FAILURE;
+        }
+        if (state.m_loop >= Loops)
+        {
+            return Result::SUCCESS;
+        }
+        int result = EnterChild(state, ctx, now, Indices());
+        if (result == Result::INSTANT)
+        {
+            return result;
+        }
+        mode = ResultToTraversal(Result(result));
+    }
+}
+
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children, typename C, typename LC, typename DC>
+template <size_t... I>
+int StaticNode<StaticBranch<Type,Loops,Attempts,Children...>,C,LC,DC>::EnterChild(State& state, C& ctx, uint64_t now, std::index_sequence<I...>)
+{
+    int result = Result::FAILURE;
+    ((state.m_ctr == I && (result = Child<I>::Enter(std::get<I>(state.m_children), ctx, now), true)) || ...);
+    return result;
+}
+
+template <BranchType Type, uint64_t Loops, uint64_t Attempts, typename... Children, typename C, typename LC, typename DC>
+template <size_t... I>
+int StaticNode<StaticBranch<Type,Loops,Attempts,Children...>,C,LC,DC>::ResumeChild(State& state, C& ctx, uint64_t now, std::index_sequence<I...>)
+{
+    int result = Result::FAILURE;
+    ((state.m_ctr == I && (result = Child<I>::Resume(std::get<I>(state.m_children), ctx, now), true)) || ...);
+    return result;
+}
+
+//
+// Static Multiplexers
+//
+
+template <auto Callback, typename... Children, typename C, typename LC, typename DC>
+int StaticNode<StaticMultiplexer<Callback,Children...>,C,LC,DC>::Enter(State& state, C& ctx, uint64_t now)
+{
+    state.m_memory = LC();
+    state.m_timer.Clear();
+    state.m_running = {};
+    return Execute(state, ctx, now);
+}
+
+template <auto Callback, typename... Children, typename C, typename LC, typename DC>
+int StaticNode<StaticMultiplexer<Callback,Children...>,C,LC,DC>::Resume(State& state, C& ctx, uint64_t now)
+{
+    if (!state.m_timer.HasPassed(now))
+    {
+        return Result::INSTANT;
+    }
+    return Execute(state, ctx, now);
+}
+
+template <auto Callback, typename... Children, typename C, typename LC, typename DC>
+int StaticNode<StaticMultiplexer<Callback,Children...>,C,LC,DC>::Execute(State& state, C& ctx, uint64_t now)
+{
+    int result = 0;
+    if constexpr (!std::is_null_pointer_v<decltype(Callback)>)
+    {
+        result = Callback(ctx, state.m_memory);
+    }
+    if (result == Result::SUCCESS || result == Result::FAILURE)
+    {
+        return result;
+    }
+    state.m_timer.Set(now, result);
+    UpdateSubtrees(state, ctx, now, Indices());
+    return Result::INSTANT;
+}
+
+template <auto Callback, typename... Children, typename C, typename LC, typename DC>
+template <size_t I>
+void StaticNode<StaticMultiplexer<Callback,Children...>,C,LC,DC>::UpdateSubtree(State& state, C& ctx, uint64_t now)
+{
+    auto& child = std::get<I>(state.m_children);
+    int result = state.m_running[I] ? Child<I>::Resume(child, ctx, now) : Child<I>::Enter(child, ctx, now);
+    state.m_running[I] = result == Result::INSTANT;
+}
+
+template <auto Callback, typename... Children, typename C, typename LC, typename DC>
+template <size_t... I>
+void StaticNode<StaticMultiplexer<Callback,Children...>,C,LC,DC>::UpdateSubtrees(State& state, C& ctx, uint64_t now, std::index_sequence<I...>)
+{
+    (UpdateSubtree<I>(state, ctx, now), ...);
+}
+
+//
+// Static Decorators
+//
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+int StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>::Enter(State& state, C& ctx, uint64_t now)
+{
+    if (!EnterDecorators(state, ctx, now, Indices()))
+    {
+        return Result::FAILURE;
+    }
+    return Node::Enter(state.m_node, ctx, now);
+}
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+int StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>::Resume(State& state, C& ctx, uint64_t now)
+{
+    if (!ResumeDecorators(state, ctx, now, Indices()))
+    {
+        return Result::FAILURE;
+    }
+    return Node::Resume(state.m_node, ctx, now);
+}
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+template <size_t I, auto Decorator>
+bool StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>::EnterDecorator(State& state, C& ctx, uint64_t now)
+{
+    state.m_memory[I] = DC();
+    int result = Decorator(ctx, state.m_memory[I]);
+    state.m_active[I] = result != Result::SUCCESS && result != Result::FAILURE;
+    if (state.m_active[I])
+    {
+        state.m_timers[I].Set(now, result);
+    }
+    return result != Result::FAILURE;
+}
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+template <size_t I, auto Decorator>
+bool StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>::ResumeDecorator(State& state, C& ctx, uint64_t now)
+{
+    if (!state.m_active[I] || !state.m_timers[I].HasPassed(now))
+    {
+        return true;
+    }
+    int result = Decorator(ctx, state.m_memory[I]);
+    switch (result)
+    {
+    case Result::SUCCESS:
+        state.m_active[I] = false;
+        return true;
+    case Result::FAILURE:
+        return false;
+    default:
+        state.m_timers[I].Set(now, result);
+        return true;
+    }
+}
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+template <size_t... I>
+bool StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>::EnterDecorators(State& state, C& ctx, uint64_t now, std::index_sequence<I...>)
+{
+    return (EnterDecorator<I, Decorators>(state, ctx, now) && ...);
+}
+
+template <typename Decorated, auto... Decorators, typename C, typename LC, typename DC>
+template <size_t... I>
+bool StaticNode<StaticDecorated<Decorated,Decorators...>,C,LC,DC>::ResumeDecorators(State& state, C& ctx, uint64_t now, std::index_sequence<I...>)
+{
+    return (ResumeDecorator<I, Decorators>(state, ctx, now) && ...);
+}
+
+//
+// Static Execution
+//
+
+template <typename Root, typename C, typename LC, typename DC>
+void StaticTreeExecutor<Root,C,LC,DC>::Update(C& ctx, uint64_t now)
+{
+    using Node = StaticNode<Root,C,LC,DC>;
+    int result = m_running ? Node::Resume(m_state, ctx, now) : Node::Enter(m_state, ctx, now);
+    m_running = result == Result::INSTANT;
+}
+
+template <typename Root, typename C, typename LC, typename DC>
+bool StaticTreeExecutor<Root,C,LC,DC>::IsRunning() const
+{
+    return m_running;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "BehaviorTree.h"
+
+//
+// Trace Replay
+//
+
+// Context of replayed executors: hands every callback the result recorded
+// for it, in the order they were recorded.
+struct TraceCursor
+{
+    TraceEvent const* m_events = nullptr;
+    size_t m_count = 0;
+    size_t m_position = 0;
+    // Throws once the replay asks for a call the trace does not have next
+    int Next(TraceEventType type);
+};
+
+struct TraceReplayResult
+{
+    // index of the update the replay started at
+    size_t m_start = 0;
+    // events after m_start that the replay reproduced before diverging
+    size_t m_matched = 0;
+    size_t m_count = 0;
+    bool Matches() const;
+};
+
+// Offline replay of a trace recorded with TreeExecutor::SetTrace.
+//
+// The structure of the tree is rebuilt with every leaf, multiplexer and
+// decorator replaced by a callback returning the recorded result, and run
+// through a regular TreeExecutor with the recorded update times, so no game
+// context is needed. Replay starts at the first update that began with an
+// empty node stack, since the state of a wrapped ring buffer before that is
+// unknown.
+template <typename C, typename LC, typename DC>
+class TraceReplay
+{
+public:
+    using ReplayTree = CompiledTree<TraceCursor, std::monostate, std::monostate>;
+
+    // Throws if the trace contains no update that can be replayed
+    static TraceReplayResult Replay(CompiledTree<C,LC,DC> const& tree, TraceEvent const* events, size_t count);
+    // The recorded tree with all callbacks replaced, for driving by hand
+    static std::shared_ptr<ReplayTree const> BuildReplayTree(CompiledTree<C,LC,DC> const& tree);
+};
+
+#include "BehaviorTreeTrace.ipp"
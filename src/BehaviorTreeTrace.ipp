@@ -0,0 +1,151 @@
+#pragma once
+
+#include "BehaviorTreeTrace.h"
+
+#include <stdexcept>
+
+inline int TraceCursor::Next(TraceEventType type)
+{
+    for (; m_position < m_count; ++m_position)
+    {
+        TraceEvent const& event = m_events[m_position];
+        if (event.m_type == TraceEventType::CALL || event.m_type == TraceEventType::DECORATOR)
+        {
+            if (event.m_type != type)
+            {
+                break;
+            }
+            m_position++;
+            return event.m_result;
+        }
+        if (event.m_type == TraceEventType::UPDATE)
+        {
+            break;
+        }
+    }
+    throw std::runtime_error("Replay diverged from the recorded trace");
+}
+
+inline bool TraceReplayResult::Matches() const
+{
+    return m_matched == m_count - m_start;
+}
+
+template <typename C, typename LC, typename DC>
+std::shared_ptr<typename TraceReplay<C,LC,DC>::ReplayTree const> TraceReplay<C,LC,DC>::BuildReplayTree(CompiledTree<C,LC,DC> const& tree)
+{
+    std::shared_ptr<ReplayTree> replay(new ReplayTree());
+    size_t childCount = 0;
+    for (size_t i = 0; i < tree.m_nodeCount; ++i)
+    {
+        childCount = std::max<size_t>(childCount, tree.m_nodes[i].m_childEnd);
+    }
+    replay->m_nodeStorage.assign(tree.m_nodes, tree.m_nodes + tree.m_nodeCount);
+    // coroutine leaves replay their recorded results like any other leaf
+    for (CompiledNode& node : replay->m_nodeStorage)
+    {
+        if (node.m_kind == NodeKind::COROUTINE_LEAF)
+        {
+            node.m_kind = NodeKind::LEAF;
+        }
+    }
+    replay->m_childStorage.assign(tree.m_children, tree.m_children + childCount);
+    replay->m_callbacks.assign(tree.m_callbacks.size(), [](TraceCursor& cursor, std::monostate&) {
+        return cursor.Next(TraceEventType::CALL);
+    });
+    replay->m_decorators.assign(tree.m_decorators.size(), [](TraceCursor& cursor, std::monostate&) {
+        return cursor.Next(TraceEventType::DECORATOR);
+    });
+    replay->m_callbackSymbols = tree.m_callbackSymbols;
+    replay->m_decoratorSymbols = tree.m_decoratorSymbols;
+    // the trace has an event for every evaluation of a per-tick callback,
+    // including those that reused a result, so each has to be replayed
+    for (CallbackSymbol& symbol : replay->m_callbackSymbols)
+    {
+        symbol.m_perTick = false;
+    }
+    for (CallbackSymbol& symbol : replay->m_decoratorSymbols)
+    {
+        symbol.m_perTick = false;
+    }
+    replay->m_decoratorEvents = tree.m_decoratorEvents;
+    replay->Finalize(replay->m_nodeStorage.data(), replay->m_nodeStorage.size(), replay->m_childStorage.data());
+    return replay;
+}
+
+template <typename C, typename LC, typename DC>
+TraceReplayResult TraceReplay<C,LC,DC>::Replay(CompiledTree<C,LC,DC> const& tree, TraceEvent const* events, size_t count)
+{
+    TraceReplayResult result;
+    result.m_count = count;
+    result.m_start = count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (events[i].m_type == TraceEventType::UPDATE && events[i].m_index == 0)
+        {
+            result.m_start = i;
+            break;
+        }
+    }
+    if (result.m_start == count)
+    {
+        throw std::runtime_error("Trace has no update starting from an empty tree");
+    }
+
+    TreeExecutor<TraceCursor> executor(BuildReplayTree(tree));
+    // a diverging replay is caught at its next callback, which is at most
+    // a few transitions per node away
+    TraceBuffer replayed(count - result.m_start + 4 * tree.NodeCount() + 1);
+    executor.SetTrace(&replayed);
+    TraceCursor cursor = { events, count, 0 };
+    try
+    {
+        for (size_t i = result.m_start; i < count; ++i)
+        {
+            if (events[i].m_type != TraceEventType::UPDATE)
+            {
+                continue;
+            }
+            // budgeted updates are replayed with the number of children
+            // they managed to enter before suspending, and events are
+            // notified again before the update that handled them
+            UpdateBudget budget;
+            uint64_t entered = 0;
+            for (size_t j = i + 1; j < count && events[j].m_type != TraceEventType::UPDATE; ++j)
+            {
+                if (events[j].m_type == TraceEventType::ADD_CHILD)
+                {
+                    entered++;
+                }
+                else if (events[j].m_type == TraceEventType::NOTIFY)
+                {
+                    executor.Notify(events[j].m_index);
+                }
+                else if (events[j].m_type == TraceEventType::SUSPEND)
+                {
+                    budget.m_transitions = entered;
+                    break;
+                }
+            }
+            cursor.m_position = i + 1;
+            executor.Update(cursor, events[i].m_time, budget);
+        }
+    }
+    catch (std::runtime_error const&)
+    {
+        // the replayed trace shows where it diverged
+    }
+
+    std::vector<TraceEvent> actual = replayed.Events();
+    while (result.m_matched < actual.size() && result.m_start + result.m_matched < count)
+    {
+        TraceEvent const& expected = events[result.m_start + result.m_matched];
+        TraceEvent const& got = actual[result.m_matched];
+        if (expected.m_type != got.m_type || expected.m_index != got.m_index || expected.m_result != got.m_result || expected.m_time != got.m_time)
+        {
+            break;
+        }
+        result.m_matched++;
+    }
+    return result;
+}
@@ -2,7 +2,35 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <array>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
+#include <map>
+#include <new>
+#include <string>
+
+static std::atomic<size_t> allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    allocations++;
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
 
 using TP = std::vector<uint32_t>;
 #define VERIFY_VEC(v1,v2) REQUIRE(v1 == TP(v2))
@@ -366,3 +394,712 @@ TEST_CASE("Decorator state") {
         REQUIRE(vec == TP({ 0,1 }));
     }
 }
+
+TEST_CASE("Compiled trees") {
+    BehaviorTreeContext<TP> ctx;
+    Leaf<TP>* shared = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; });
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddNode(shared)
+        ->AddSelector([=](Branch<TP>* builder) { builder
+            ->AddNode(shared)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(1); return Result::SUCCESS; })
+        ;})
+    ;
+
+    SECTION("Shared nodes are compiled once") {
+        REQUIRE(ctx.Compile(root)->NodeCount() == 4);
+    }
+
+    SECTION("Compilations are cached until modified") {
+        auto first = ctx.Compile(root);
+        REQUIRE(ctx.Compile(root) == first);
+        root->AddLeaf([](TP& v, MS&) { v.push_back(2); return Result::SUCCESS; });
+        REQUIRE(ctx.Compile(root) != first);
+        REQUIRE(ctx.Compile(root)->NodeCount() == 5);
+    }
+
+    SECTION("Executors can share a compiled tree") {
+        auto tree = ctx.Compile(root);
+        TreeExecutor<TP> exec1(tree);
+        TreeExecutor<TP> exec2(tree);
+        TP vec;
+        exec1.Update(vec, 0);
+        exec2.Update(vec, 0);
+        REQUIRE(vec == TP({ 0,0,0,0 }));
+    }
+}
+
+TEST_CASE("Failing decorator unloads delayed siblings") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSelector()
+        ->AddLeaf([](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; }, [](Leaf<TP>* leaf) { leaf
+            ->Decorate([](TP& v, MS&) { v.push_back(1); return 1; })
+            ->Decorate([](TP& v, MS&) { v.push_back(2); return Result::FAILURE; })
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.push_back(3); return 1; })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    exec.Update(vec, 0);
+    exec.Update(vec, 1);
+    REQUIRE(vec == TP({ 1,2,3,3 }));
+}
+
+TEST_CASE("Delayed decorator failing later fails its node") {
+    BehaviorTreeContext<TP> ctx;
+    int calls = 0;
+    Branch<TP>* root = ctx.CreateSelector()
+        ->AddLeaf([](TP& v, MS&) { v.push_back(0); return 5; }, [&](Leaf<TP>* leaf) { leaf
+            ->Decorate([&](TP& v, MS&) { v.push_back(1); return calls++ == 0 ? 1 : Result::FAILURE; })
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.push_back(2); return Result::SUCCESS; })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    exec.Update(vec, 0);
+    exec.Update(vec, 1);
+    REQUIRE(vec == TP({ 1,0,1,2 }));
+}
+
+TEST_CASE("Interrupted root restarts without its old delay") {
+    BehaviorTreeContext<TP> ctx;
+    int calls = 0;
+    Leaf<TP>* root = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return 5; })
+        ->Decorate([&](TP& v, MS&) { v.push_back(1); return calls++ == 1 ? Result::FAILURE : 1; })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    exec.Update(vec, 0);
+    exec.Update(vec, 1);
+    exec.Update(vec, 2);
+    REQUIRE(vec == TP({ 1,0,1,1,0 }));
+}
+
+TEST_CASE("Budgeted updates") {
+    BehaviorTreeContext<TP> ctx;
+    Multiplexer<TP>* root = ctx.CreateMultiplexer([](TP& v, MS&) { v.push_back(9); return 1; })
+        ->AddSequence([](Branch<TP>* builder) { builder
+            ->SetLoops(20)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(v.size() % 7); return Result::SUCCESS; })
+        ;})
+        ->AddSelector([](Branch<TP>* builder) { builder
+            ->SetLoops(20)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(20); return Result::FAILURE; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(21); return Result::SUCCESS; })
+        ;})
+    ;
+    TreeExecutor<TP> unbudgeted(&ctx, root);
+    TreeExecutor<TP> budgeted(&ctx, root);
+    TP expected;
+    TP vec;
+    for (uint64_t now = 0; now < 3; ++now)
+    {
+        unbudgeted.Update(expected, now);
+        int suspensions = 0;
+        UpdateBudget budget;
+        budget.m_transitions = 7;
+        while (budgeted.Update(vec, now, budget))
+        {
+            REQUIRE(budget.m_transitions == 0);
+            REQUIRE(budgeted.IsSuspended());
+            budget.m_transitions = 7;
+            suspensions++;
+        }
+        REQUIRE(suspensions > 5);
+        REQUIRE(vec == expected);
+    }
+
+    SECTION("Plain updates resume suspended ones") {
+        UpdateBudget budget;
+        budget.m_transitions = 3;
+        REQUIRE(budgeted.Update(vec, 3, budget));
+        budgeted.Update(vec, 3);
+        unbudgeted.Update(expected, 3);
+        REQUIRE(!budgeted.IsSuspended());
+        REQUIRE(vec == expected);
+    }
+}
+
+TEST_CASE("Event decorators") {
+    BehaviorTreeContext<TP> ctx;
+    TreeEventId targetChanged = ctx.Callbacks().RegisterEvent("targetChanged");
+    TreeEventId other = ctx.Callbacks().RegisterEvent("other");
+    int evaluations = 0;
+    bool valid = true;
+    Branch<TP>* root = ctx.CreateSelector()
+        ->AddLeaf([](TP& v, MS&) { v.push_back(0); return 100; }, [&](Leaf<TP>* leaf) { leaf
+            ->DecorateOn("targetChanged", [&](TP&, MS&) { evaluations++; return valid ? Result::SUCCESS : Result::FAILURE; })
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.push_back(1); return 100; })
+    ;
+    REQUIRE(ctx.Callbacks().RegisterEvent("targetChanged") == targetChanged);
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    for (uint64_t now = 0; now < 50; ++now)
+    {
+        exec.Update(vec, now);
+    }
+    // never polled, only evaluated when entered
+    REQUIRE(evaluations == 1);
+    REQUIRE(exec.NextUpdateTime() == 100);
+
+    exec.Notify(other);
+    REQUIRE(exec.NextUpdateTime() == 100);
+    exec.Notify(targetChanged);
+    REQUIRE(exec.NextUpdateTime() == 0);
+    exec.Update(vec, 50);
+    exec.Update(vec, 51);
+    REQUIRE(evaluations == 2);
+    REQUIRE(vec == TP({ 0 }));
+
+    // interrupts the decorated node like any failing decorator
+    valid = false;
+    exec.Notify(targetChanged);
+    exec.Update(vec, 52);
+    REQUIRE(evaluations == 3);
+    REQUIRE(vec == TP({ 0,1 }));
+    REQUIRE_THROWS_AS(ctx.Callbacks().GetEvent("missing"), std::runtime_error);
+}
+
+TEST_CASE("Tick intervals") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddLeaf([](TP& v, MS&) { v.push_back(0); return v.size() == 1 ? 7 : Result::SUCCESS; })
+        ->AddLeaf([](TP& v, MS&) { v.push_back(1); return v.size() < 6 ? 0 : Result::SUCCESS; })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    exec.SetTickInterval(5);
+    TP vec;
+    std::vector<uint64_t> updates;
+    for (uint64_t now = 0; now < 25; ++now)
+    {
+        size_t size = vec.size();
+        exec.Update(vec, now);
+        if (vec.size() != size)
+        {
+            updates.push_back(now);
+        }
+    }
+    // the delay ends right at its deadline, the running leaf after it is
+    // only executed once per interval
+    REQUIRE(updates == std::vector<uint64_t>({ 0,7,12,17,22 }));
+    REQUIRE(vec == TP({ 0,0,1,1,1,1 }));
+    REQUIRE(exec.NextUpdateTime() == 27);
+
+    SECTION("Changing the interval applies on the next update") {
+        exec.SetTickInterval(1);
+        REQUIRE(exec.NextUpdateTime() == 23);
+        exec.SetTickInterval(0);
+        exec.Update(vec, 22);
+        REQUIRE(vec == TP({ 0,0,1,1,1,1,0,1 }));
+    }
+}
+
+TEST_CASE("Steady state updates do not allocate") {
+    BehaviorTreeContext<TP> ctx;
+    auto captured = std::make_shared<int>(0);
+    long maxUseCount = 0;
+    bool delayed = false;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->Decorate([captured](TP& v, MS&) { return 2; })
+        ->AddSelector([&](Branch<TP>* builder) { builder
+            ->SetLoops(3)
+            ->AddLeaf([captured](TP& v, MS&) { return Result::FAILURE; })
+            ->AddLeaf([captured, &maxUseCount](TP& v, MS&) {
+                maxUseCount = std::max(maxUseCount, captured.use_count());
+                return Result::SUCCESS;
+            }, [captured](Leaf<TP>* leaf) { leaf
+                ->Decorate([captured](TP& v, MS&) { return Result::SUCCESS; })
+            ;})
+        ;})
+        ->AddLeaf([captured, &delayed](TP& v, MS&) {
+            delayed = !delayed;
+            return delayed ? 1 : Result::SUCCESS;
+        }, [captured](Leaf<TP>* leaf) { leaf
+            ->Decorate([captured](TP& v, MS&) { return 1; })
+        ;})
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    for (uint64_t now = 0; now < 8; ++now)
+    {
+        exec.Update(vec, now);
+    }
+
+    long useCount = captured.use_count();
+    size_t before = allocations;
+    for (uint64_t now = 8; now < 1000; ++now)
+    {
+        exec.Update(vec, now);
+    }
+    REQUIRE(allocations == before);
+    REQUIRE(maxUseCount == useCount);
+}
+
+TEST_CASE("Re-entering multiplexers does not allocate") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddMultiplexer([](TP& v, MS&) { return v.size() >= 4 ? Result::SUCCESS : 1; }, [](Multiplexer<TP>* builder) { builder
+            ->AddLeaf([](TP& v, MS&) { v.push_back(0); return 1; })
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->AddLeaf([](TP& v, MS&) { v.push_back(1); return Result::SUCCESS; })
+                ->AddMultiplexer([](Multiplexer<TP>* builder) { builder
+                    ->AddLeaf([](TP& v, MS&) { return 1; })
+                ;})
+            ;})
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.clear(); return Result::SUCCESS; })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    vec.reserve(64);
+    for (uint64_t now = 0; now < 8; ++now)
+    {
+        exec.Update(vec, now);
+    }
+
+    size_t before = allocations;
+    for (uint64_t now = 8; now < 1000; ++now)
+    {
+        exec.Update(vec, now);
+    }
+    REQUIRE(allocations == before);
+}
+
+TEST_CASE("Restarting a multiplexer root") {
+    BehaviorTreeContext<TP> ctx;
+    Multiplexer<TP>* root = ctx.CreateMultiplexer([](TP& v, MS&) { v.push_back(9); return v.size() % 3 == 0 ? Result::SUCCESS : 0; })
+        ->AddLeaf([](TP& v, MS&) { v.push_back(0); return 0; })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    exec.Update(vec, 0);
+    exec.Update(vec, 0);
+    exec.Update(vec, 0);
+    REQUIRE(vec == TP({ 9,0,9,9,0 }));
+}
+
+TEST_CASE("Tree arenas") {
+    BehaviorTreeContext<TP> ctx;
+    auto sentinel = std::make_shared<int>(0);
+
+    TreeArenaId first = ctx.BeginTreeArena();
+    Branch<TP>* firstRoot = ctx.CreateSequence()
+        ->AddLeaf([sentinel](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; })
+        ->Decorate([sentinel](TP& v, MS&) { return 1; })
+    ;
+    ctx.EndTreeArena();
+
+    ctx.BeginTreeArena();
+    Branch<TP>* secondRoot = ctx.CreateSelector()
+        ->AddLeaf([](TP& v, MS&) { v.push_back(1); return Result::SUCCESS; })
+    ;
+    ctx.EndTreeArena();
+
+    TreeExecutor<TP> firstExec(&ctx, firstRoot);
+    TreeExecutor<TP> secondExec(&ctx, secondRoot);
+    TP vec;
+    firstExec.Update(vec, 0);
+    long compiledUseCount = sentinel.use_count();
+
+    SECTION("Release one tree at a time") {
+        ctx.ReleaseTreeArena(first);
+        // only the executors compiled copies are left
+        REQUIRE(sentinel.use_count() < compiledUseCount);
+        secondExec.Update(vec, 0);
+        firstExec.Update(vec, 1);
+        REQUIRE(vec == TP({ 0,1,0 }));
+        REQUIRE_THROWS_AS(ctx.ReleaseTreeArena(first), std::runtime_error);
+    }
+
+    SECTION("Build with few allocations") {
+        size_t before = allocations;
+        ctx.BeginTreeArena(64 * 1024);
+        Branch<TP>* root = ctx.CreateSequence();
+        for (int i = 0; i < 500; ++i)
+        {
+            root->AddLeaf([](TP& v, MS&) { return Result::SUCCESS; });
+        }
+        ctx.EndTreeArena();
+        REQUIRE(allocations - before < 10);
+    }
+}
+
+TEST_CASE("Registered callbacks") {
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterLeaf("push", [](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; });
+    ctx.Callbacks().RegisterLeafFactory("pushArg", [](CallbackArgs const& args) {
+        uint32_t value = uint32_t(args.at(0));
+        return [=](TP& v, MS&) { v.push_back(value); return Result::SUCCESS; };
+    });
+    ctx.Callbacks().RegisterDecoratorFactory("sizeBelow", [](CallbackArgs const& args) {
+        size_t limit = size_t(args.at(0));
+        return [=](TP& v, MS&) { return v.size() < limit ? 0 : Result::FAILURE; };
+    });
+
+    Branch<TP>* root = ctx.CreateSequence()
+        ->Decorate("sizeBelow", { 5 })
+        ->AddLeaf("push")
+        ->AddLeaf("pushArg", { 7 })
+        ->AddLeaf("pushArg", { 8 })
+    ;
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+    for (int i = 0; i < 4; ++i)
+    {
+        exec.Update(vec, i);
+    }
+    REQUIRE(vec == TP({ 0,7,8,0,7,8 }));
+
+    REQUIRE_THROWS_AS(ctx.CreateLeaf("missing"), std::runtime_error);
+    REQUIRE_THROWS_AS(ctx.CreateLeaf("push", { 1 }), std::runtime_error);
+}
+
+TEST_CASE("Interning") {
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterDecorator("lowHealth", [](TP& v, MS&) { return v.size() % 4 < 2 ? Result::SUCCESS : Result::FAILURE; });
+    ctx.Callbacks().RegisterLeafFactory("push", [](CallbackArgs const& args) {
+        uint32_t value = uint32_t(args.at(0));
+        return [=](TP& v, MS&) { v.push_back(value); return 1; };
+    });
+    auto flee = [](Branch<TP>* builder) { builder
+        ->Decorate("lowHealth")
+        ->AddLeaf("push", { 1 })
+        ->AddLeaf("push", { 2 })
+    ;};
+    auto build = [&](uint32_t last) {
+        return ctx.CreateSelector()
+            ->AddSequence(flee)
+            ->AddSequence(flee)
+            ->AddLeaf("push", { double(last) })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(9); return Result::SUCCESS; })
+        ;
+    };
+    std::vector<Node<TP,MS,MS>*> roots = { build(3), build(3), build(4) };
+    auto run = [&](Node<TP,MS,MS>* root) {
+        TreeExecutor<TP> exec(&ctx, root);
+        TP vec;
+        for (int i = 0; i < 20; ++i)
+        {
+            exec.Update(vec, i);
+        }
+        return vec;
+    };
+    std::vector<TP> expected;
+    for (Node<TP,MS,MS>* root : roots)
+    {
+        expected.push_back(run(root));
+    }
+    REQUIRE(ctx.Compile(roots[0])->NodeCount() == 9);
+
+    InternStats stats = ctx.Intern(roots);
+    // every flee sequence but one with its leaves, and one "push 3"
+    REQUIRE(stats.m_nodes == 27);
+    REQUIRE(stats.m_merged == 5 * 3 + 1);
+    REQUIRE(stats.m_bytesSaved >= stats.m_merged * sizeof(Leaf<TP>));
+    // the lambda leaves keep the roots apart
+    REQUIRE(roots[0] != roots[1]);
+    REQUIRE(ctx.Compile(roots[0])->NodeCount() == 6);
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        REQUIRE(run(roots[i]) == expected[i]);
+    }
+    REQUIRE(ctx.Intern(roots).m_merged == 0);
+
+    SECTION("Arenas are interned separately") {
+        TreeArenaId arena = ctx.BeginTreeArena();
+        Node<TP,MS,MS>* arenaRoot = build(3);
+        ctx.EndTreeArena();
+        std::vector<Node<TP,MS,MS>*> arenaRoots = { arenaRoot };
+        REQUIRE(ctx.Intern(arenaRoots).m_merged == 3);
+        ctx.ReleaseTreeArena(arena);
+        REQUIRE(run(roots[2]) == expected[2]);
+    }
+}
+
+TEST_CASE("Per-tick callbacks") {
+    BehaviorTreeContext<TP> ctx;
+    std::map<uint32_t, uint32_t> calls;
+    ctx.Callbacks().RegisterDecorator("hasTarget", [&](TP&, MS&) { calls[0]++; return Result::SUCCESS; });
+    ctx.Callbacks().RegisterLeaf("inRange", [&](TP&, MS&) { calls[1]++; return Result::SUCCESS; });
+    ctx.Callbacks().RegisterDecoratorFactory("check", [&](CallbackArgs const& args) {
+        uint32_t id = uint32_t(args.at(0));
+        return [&, id](TP&, MS&) { calls[id]++; return Result::SUCCESS; };
+    });
+    Multiplexer<TP>* root = ctx.CreateMultiplexer()
+        ->AddSequence([](Branch<TP>* builder) { builder
+            ->Decorate("hasTarget")
+            ->Decorate("check", { 2 })
+            ->AddLeaf("inRange")
+            ->AddLeaf("inRange")
+            ->AddLeaf([](TP& v, MS&) { v.push_back(1); return Result::SUCCESS; })
+        ;})
+        ->AddLeaf("inRange", [](Leaf<TP>* builder) { builder
+            ->Decorate("hasTarget")
+            ->Decorate("check", { 2 })
+            ->Decorate("check", { 3 })
+        ;})
+    ;
+
+    SECTION("Unmarked callbacks are called for every node") {
+        TreeExecutor<TP> exec(&ctx, root);
+        TP vec;
+        exec.Update(vec, 0);
+        REQUIRE(calls == std::map<uint32_t, uint32_t>({ { 0, 2 }, { 1, 3 }, { 2, 2 }, { 3, 1 } }));
+    }
+
+    SECTION("Marked callbacks are called once per update") {
+        ctx.Callbacks().MarkDecoratorPerTick("hasTarget");
+        ctx.Callbacks().MarkDecoratorPerTick("check");
+        ctx.Callbacks().MarkLeafPerTick("inRange");
+        TreeExecutor<TP> exec(&ctx, root);
+        TP vec;
+        exec.Update(vec, 0);
+        REQUIRE(calls == std::map<uint32_t, uint32_t>({ { 0, 1 }, { 1, 1 }, { 2, 1 }, { 3, 1 } }));
+        exec.Update(vec, 1);
+        REQUIRE(calls == std::map<uint32_t, uint32_t>({ { 0, 2 }, { 1, 2 }, { 2, 2 }, { 3, 2 } }));
+        REQUIRE(vec == TP({ 1, 1 }));
+    }
+}
+
+struct Patrol
+{
+    uint32_t m_step = 0;
+    std::string m_route = "north";
+};
+
+// counts instances alive, to check when typed memory is destroyed
+struct Tracked
+{
+    static inline int s_live = 0;
+    uint32_t m_evaluations = 0;
+    Tracked() { s_live++; }
+    Tracked(Tracked const& other) : m_evaluations(other.m_evaluations) { s_live++; }
+    Tracked(Tracked&& other) noexcept : m_evaluations(other.m_evaluations) { s_live++; }
+    ~Tracked() { s_live--; }
+};
+
+struct Big
+{
+    std::array<uint32_t, 64> m_values = {};
+    std::string m_tag;
+};
+
+TEST_CASE("Typed node memory") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("Leaves keep their own memory") {
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddTypedLeaf<Patrol>([](TP& v, Patrol& patrol) {
+                REQUIRE(patrol.m_route == "north");
+                v.push_back(++patrol.m_step);
+                return patrol.m_step < 3 ? 1 : int(Result::SUCCESS);
+            })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; })
+        ;
+        TreeExecutor<TP> exec(&ctx, root);
+        TP vec;
+        exec.Update(vec, 0);
+        REQUIRE(exec.NodeMemory().Size() == sizeof(Patrol));
+        exec.Update(vec, 1);
+        exec.Update(vec, 2);
+        REQUIRE(exec.NodeMemory().Size() == 0);
+        exec.Update(vec, 3);
+        VERIFY_VEC(vec, TP({ 1, 2, 3, 0, 1 }));
+    }
+
+    SECTION("Decorators keep their own memory") {
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddLeaf([](TP& v, MS&) { v.push_back(0); return 1; }, [](Leaf<TP>* builder) { builder
+                ->DecorateTyped<Tracked>([](TP& v, Tracked& tracked) {
+                    v.push_back(10 + ++tracked.m_evaluations);
+                    return tracked.m_evaluations < 3 ? 1 : int(Result::FAILURE);
+                })
+            ;})
+        ;
+        TreeExecutor<TP> exec(&ctx, root);
+        TP vec;
+        for (uint64_t i = 0; i < 4; ++i)
+        {
+            exec.Update(vec, i);
+        }
+        VERIFY_VEC(vec, TP({ 11, 0, 12, 0, 13, 11, 0 }));
+    }
+
+    SECTION("Memory only lives while its node runs") {
+        bool abort = false;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddTypedLeaf<Tracked>([](TP&, Tracked&) { return 1; }, [&](Leaf<TP>* builder) { builder
+                ->DecorateTyped<Tracked>([&](TP&, Tracked&) { return abort ? int(Result::FAILURE) : 1; })
+            ;})
+        ;
+        {
+            TreeExecutor<TP> exec(&ctx, root);
+            TP vec;
+            exec.Update(vec, 0);
+            REQUIRE(Tracked::s_live == 2);
+            {
+                TreeExecutor<TP> copy = exec;
+                REQUIRE(Tracked::s_live == 4);
+            }
+            REQUIRE(Tracked::s_live == 2);
+            abort = true;
+            exec.Update(vec, 1);
+            REQUIRE(Tracked::s_live == 0);
+            REQUIRE(exec.NodeStackDepth() == 0);
+            abort = false;
+            exec.Update(vec, 2);
+            REQUIRE(Tracked::s_live == 2);
+        }
+        REQUIRE(Tracked::s_live == 0);
+    }
+
+    SECTION("Growing relocates live memory") {
+        auto check = [](TP& v, Big& big) {
+            if (big.m_tag.empty())
+            {
+                big.m_tag = std::string(32, 'x');
+                big.m_values.fill(7);
+            }
+            else
+            {
+                v.push_back(big.m_tag == std::string(32, 'x') && big.m_values.back() == 7);
+            }
+            return 1;
+        };
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddSequence([&](Branch<TP>* builder) { builder
+                ->DecorateTyped<Big>(check)
+                ->AddSequence([&](Branch<TP>* builder) { builder
+                    ->DecorateTyped<Big>(check)
+                    ->AddTypedLeaf<Big>(check)
+                ;})
+            ;})
+        ;
+        TreeExecutor<TP> exec(&ctx, root);
+        TP vec;
+        exec.Update(vec, 0);
+        exec.Update(vec, 1);
+        VERIFY_VEC(vec, TP({ 1, 1, 1 }));
+        REQUIRE(exec.NodeMemory().Size() >= 3 * sizeof(Big));
+    }
+}
+
+TEST_CASE("Replacing trees") {
+    BehaviorTreeContext<TP,InitInteger> ctx;
+    CallbackRegistry<TP,InitInteger>& callbacks = ctx.Callbacks();
+    callbacks.RegisterLeafFactory("push", [](CallbackArgs const& args) {
+        uint32_t value = uint32_t(args.at(0));
+        return [value](TP& v, InitInteger&) { v.push_back(value); return Result::SUCCESS; };
+    });
+    callbacks.RegisterLeaf("count", [](TP& v, InitInteger& i) {
+        v.push_back(10 + i.i++);
+        return i.i < 3 ? 1 : int(Result::SUCCESS);
+    });
+    callbacks.RegisterDecorator("wait", [](TP& v, InitInteger&) { v.push_back(5); return 10; });
+    auto push = [](uint32_t value) {
+        return [value](TP& v, InitInteger&) { v.push_back(value); return Result::SUCCESS; };
+    };
+    auto build = [&](uint32_t tag) {
+        return ctx.CreateSequence()
+            ->AddLeaf("push", { double(tag + 1) })
+            ->AddLeaf("count", [&](Leaf<TP,InitInteger>* builder) { builder
+                ->Decorate("wait")
+            ;})
+            ->AddLeaf("push", { double(tag + 3) })
+        ;
+    };
+    TreeExecutor<TP,InitInteger> exec(&ctx, build(0));
+    TP vec;
+    exec.Update(vec, 0);
+    VERIFY_VEC(vec, TP({ 1, 5, 10 }));
+
+    SECTION("Matching paths keep their state") {
+        Branch<TP,InitInteger>* root = build(100);
+        exec.ReplaceTree(root);
+        REQUIRE(exec.RootNode() == root);
+        exec.Update(vec, 1);
+        exec.Update(vec, 2);
+        // the decorator keeps waiting, the leaf keeps its memory
+        VERIFY_VEC(vec, TP({ 1, 5, 10, 11, 12, 103 }));
+    }
+
+    SECTION("Lambda leaves start over") {
+        auto lambdaTree = [&](uint32_t tag) {
+            return ctx.CreateSequence()
+                ->AddLeaf([tag](TP& v, InitInteger& i) { v.push_back(tag + i.i++); return 1; })
+            ;
+        };
+        TreeExecutor<TP,InitInteger> lambdas(&ctx, lambdaTree(0));
+        TP out;
+        lambdas.Update(out, 0);
+        lambdas.Update(out, 1);
+        lambdas.ReplaceTree(lambdaTree(100));
+        lambdas.Update(out, 2);
+        VERIFY_VEC(out, TP({ 0, 1, 100 }));
+    }
+
+    SECTION("Branches with other loops do not match") {
+        exec.ReplaceTree(build(0)->SetLoops(2));
+        exec.Update(vec, 1);
+        VERIFY_VEC(vec, TP({ 1, 5, 10, 1, 5, 10 }));
+    }
+
+    SECTION("Changed nodes fall back to their parent") {
+        exec.ReplaceTree(ctx.CreateSequence()
+            ->AddLeaf(push(101))
+            ->AddSequence([&](Branch<TP,InitInteger>* builder) { builder
+                ->AddLeaf(push(104))
+            ;})
+            ->AddLeaf(push(103))
+        );
+        REQUIRE(exec.NextUpdateTime() == 0);
+        exec.Update(vec, 0);
+        VERIFY_VEC(vec, TP({ 1, 5, 10, 104, 103 }));
+    }
+
+    SECTION("Removed children start over") {
+        exec.ReplaceTree(ctx.CreateSequence()
+            ->AddLeaf(push(101))
+        );
+        exec.Update(vec, 0);
+        VERIFY_VEC(vec, TP({ 1, 5, 10, 101 }));
+        REQUIRE(exec.NodeStackDepth() == 0);
+    }
+
+    SECTION("Another root restarts") {
+        exec.ReplaceTree(ctx.CreateSelector()
+            ->AddLeaf(push(107))
+        );
+        exec.Update(vec, 0);
+        VERIFY_VEC(vec, TP({ 1, 5, 10, 107 }));
+    }
+
+    SECTION("Multiplexer subtrees keep their state") {
+        callbacks.RegisterLeafFactory("tick", [](CallbackArgs const& args) {
+            uint32_t tag = uint32_t(args.at(0));
+            return [tag](TP& v, InitInteger& i) { v.push_back(tag + i.i++); return 0; };
+        });
+        auto build = [&]() {
+            return ctx.CreateMultiplexer()
+                ->AddLeaf("tick", { 0.0 })
+                ->AddLeaf("tick", { 50 })
+            ;
+        };
+        TreeExecutor<TP,InitInteger> multiplexed(&ctx, build());
+        TP out;
+        multiplexed.Update(out, 0);
+        Multiplexer<TP,InitInteger>* root = build();
+        multiplexed.ReplaceTree(root);
+        REQUIRE(multiplexed.RootNode() == root);
+        multiplexed.Update(out, 0);
+        VERIFY_VEC(out, TP({ 0, 50, 1, 51 }));
+        // a subtree built with other arguments starts over
+        multiplexed.ReplaceTree(ctx.CreateMultiplexer()
+            ->AddLeaf("tick", { 0.0 })
+            ->AddLeaf("tick", { 60 })
+        );
+        multiplexed.Update(out, 0);
+        VERIFY_VEC(out, TP({ 0, 50, 1, 51, 2, 60 }));
+    }
+}
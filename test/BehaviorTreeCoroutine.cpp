@@ -0,0 +1,192 @@
+#include "BehaviorTreeSerialization.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+static TreeTask Patrol(TP& v)
+{
+    v.push_back(1);
+    co_await TreeDelay{ 2 };
+    v.push_back(2);
+    co_await TreeDelay{ 1 };
+    v.push_back(3);
+    co_return Result::SUCCESS;
+}
+
+static TreeTask Check(TP& v, uint32_t value)
+{
+    v.push_back(value);
+    co_await TreeDelay{ 1 };
+    co_return value % 2 == 0 ? Result::SUCCESS : Result::FAILURE;
+}
+
+static TreeTask CheckAll(TP& v)
+{
+    int first = co_await Check(v, 4);
+    int second = co_await Check(v, 5);
+    v.push_back(first == Result::SUCCESS && second == Result::FAILURE ? 10 : 11);
+    co_return second;
+}
+
+// throws on its first run only
+static TreeTask ThrowOnce(TP& v, int& runs)
+{
+    v.push_back(uint32_t(10 + runs));
+    co_await TreeDelay{ 1 };
+    if (runs++ == 0)
+    {
+        throw std::runtime_error("first run");
+    }
+    co_return Result::SUCCESS;
+}
+
+// destroyed with the frame it lives in
+struct FrameGuard
+{
+    int& m_live;
+    FrameGuard(int& live) : m_live(live) { m_live++; }
+    ~FrameGuard() { m_live--; }
+};
+
+static TP Run(TreeExecutor<TP>& executor, uint64_t updates)
+{
+    TP v;
+    for (uint64_t i = 0; i < updates; ++i)
+    {
+        executor.Update(v, i);
+    }
+    return v;
+}
+
+TEST_CASE("Coroutine leaves") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("Delays") {
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddCoroutineLeaf(&Patrol)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(4); return Result::SUCCESS; })
+        ;
+        TreeExecutor<TP> executor(&ctx, root);
+        REQUIRE(Run(executor, 7) == TP({ 1, 2, 3, 4, 1, 2 }));
+    }
+
+    SECTION("Same transitions as a leaf keeping its state in memory") {
+        BehaviorTreeContext<TP,int> plain;
+        Branch<TP,int>* plainRoot = plain.CreateSelector()
+            ->AddLeaf([](TP& v, int& step) {
+                v.push_back(uint32_t(step + 1));
+                switch (step++)
+                {
+                case 0: return 2;
+                case 1: return 1;
+                default: return int(Result::SUCCESS);
+                }
+            })
+        ;
+        BehaviorTreeContext<TP,int> coroutine;
+        Branch<TP,int>* coroutineRoot = coroutine.CreateSelector()
+            ->AddCoroutineLeaf(&Patrol)
+        ;
+        TreeExecutor<TP,int> plainExecutor(&plain, plainRoot);
+        TreeExecutor<TP,int> coroutineExecutor(&coroutine, coroutineRoot);
+        TP expected;
+        TP actual;
+        for (uint64_t i = 0; i < 20; ++i)
+        {
+            plainExecutor.Update(expected, i);
+            coroutineExecutor.Update(actual, i);
+            REQUIRE(actual == expected);
+            REQUIRE(coroutineExecutor.NextUpdateTime() == plainExecutor.NextUpdateTime());
+        }
+    }
+
+    SECTION("Awaiting tasks") {
+        Branch<TP>* root = ctx.CreateSelector()
+            ->AddCoroutineLeaf(&CheckAll)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(12); return Result::SUCCESS; })
+        ;
+        TreeExecutor<TP> executor(&ctx, root);
+        REQUIRE(Run(executor, 3) == TP({ 4, 5, 10, 12 }));
+    }
+
+    SECTION("Interrupting decorators destroy frames") {
+        int live = 0;
+        bool abort = false;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddCoroutineLeaf([&](TP& v) -> TreeTask {
+                FrameGuard guard(live);
+                for (;;)
+                {
+                    v.push_back(1);
+                    co_await CheckAll(v);
+                    co_await TreeDelay{ 1 };
+                }
+            }, [&](Leaf<TP>* builder) { builder
+                ->Decorate([&](TP&, MS&) { return abort ? Result::FAILURE : 1; })
+            ;})
+        ;
+        TreeExecutor<TP> executor(&ctx, root);
+        TP v;
+        executor.Update(v, 0);
+        executor.Update(v, 1);
+        REQUIRE(live == 1);
+        abort = true;
+        executor.Update(v, 2);
+        REQUIRE(live == 0);
+        REQUIRE(executor.NodeStackDepth() == 0);
+    }
+
+    SECTION("Frames are reused") {
+        Branch<TP>* root = ctx.CreateSelector()
+            ->AddCoroutineLeaf(&CheckAll)
+            ->AddCoroutineLeaf(&Patrol)
+        ;
+        TreeExecutor<TP> executor(&ctx, root);
+        TP v;
+        for (uint64_t i = 0; i < 50; ++i)
+        {
+            executor.Update(v, i);
+        }
+        TreeFramePool const& pool = executor.FramePool();
+        // CheckAll and one Check at a time, then Patrol
+        REQUIRE(pool.Allocations() <= 3);
+        REQUIRE(pool.LiveFrames() <= 2);
+    }
+
+    SECTION("Copies restart coroutines") {
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddCoroutineLeaf(&Patrol)
+        ;
+        TreeExecutor<TP> executor(&ctx, root);
+        TP v;
+        executor.Update(v, 0);
+        TreeExecutor<TP> copy = executor;
+        executor.Update(v, 2);
+        copy.Update(v, 2);
+        REQUIRE(v == TP({ 1, 2, 1 }));
+    }
+
+    SECTION("Throwing coroutines start again") {
+        int runs = 0;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddCoroutineLeaf([&runs](TP& v) { return ThrowOnce(v, runs); })
+        ;
+        TreeExecutor<TP> executor(&ctx, root);
+        TP v;
+        executor.Update(v, 0);
+        REQUIRE_THROWS_AS(executor.Update(v, 1), std::runtime_error);
+        REQUIRE(executor.FramePool().LiveFrames() == 0);
+        executor.Update(v, 2);
+        executor.Update(v, 3);
+        REQUIRE(v == TP({ 10, 11 }));
+    }
+
+    SECTION("Coroutine leaves cannot be serialized") {
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddCoroutineLeaf(&Patrol)
+        ;
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::Save(*ctx.Compile(root)), std::runtime_error);
+    }
+}
@@ -0,0 +1,88 @@
+#include "BehaviorTreeParallel.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+static Branch<TP>* BuildAgent(BehaviorTreeContext<TP>& ctx)
+{
+    return ctx.CreateSequence()
+        ->Decorate([](TP& v, MS&) { v.push_back(0); return 2; })
+        ->AddSelector([](Branch<TP>* builder) { builder
+            ->SetLoops(4)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(1); return v.size() % 2 ? Result::FAILURE : Result::SUCCESS; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(2); return Result::SUCCESS; })
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.push_back(3); return int(v.size() % 4); })
+    ;
+}
+
+TEST_CASE("UpdateAll matches sequential updates") {
+    constexpr size_t AGENTS = 1000;
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = BuildAgent(ctx);
+    ctx.Freeze();
+
+    std::vector<TreeExecutor<TP>> sequential(AGENTS, TreeExecutor<TP>(&ctx, root));
+    std::vector<TreeExecutor<TP>> parallel(AGENTS, TreeExecutor<TP>(&ctx, root));
+    std::vector<TP> sequentialOut(AGENTS);
+    std::vector<TP> parallelOut(AGENTS);
+    std::vector<ExecutorBinding<TP>> bindings;
+    for (size_t i = 0; i < AGENTS; ++i)
+    {
+        bindings.push_back({ &parallel[i], &parallelOut[i] });
+    }
+
+    TreeThreadPool pool(4);
+    for (uint64_t now = 0; now < 50; ++now)
+    {
+        for (size_t i = 0; i < AGENTS; ++i)
+        {
+            sequential[i].Update(sequentialOut[i], now);
+        }
+        UpdateAll(pool, bindings.data(), bindings.size(), now, 16);
+    }
+    REQUIRE(sequentialOut == parallelOut);
+}
+
+TEST_CASE("UpdateAll rethrows callback errors") {
+    BehaviorTreeContext<TP> ctx;
+    Leaf<TP>* leaf = ctx.CreateLeaf([](TP& v, MS&) -> int { throw std::runtime_error("leaf"); });
+    ctx.Freeze();
+    std::vector<TreeExecutor<TP>> executors(100, TreeExecutor<TP>(&ctx, leaf));
+    std::vector<TP> out(100);
+    std::vector<ExecutorBinding<TP>> bindings;
+    for (size_t i = 0; i < executors.size(); ++i)
+    {
+        bindings.push_back({ &executors[i], &out[i] });
+    }
+    TreeThreadPool pool(3);
+    REQUIRE_THROWS_AS(UpdateAll(pool, bindings.data(), bindings.size(), 0), std::runtime_error);
+}
+
+TEST_CASE("Frozen contexts") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = BuildAgent(ctx);
+    TreeExecutor<TP> exec(&ctx, root);
+    TP vec;
+
+    SECTION("Reject modification") {
+        ctx.Freeze();
+        REQUIRE_THROWS_AS(ctx.CreateSequence(), std::runtime_error);
+        REQUIRE_THROWS_AS(ctx.CreateLeaf([](TP&, MS&) { return 0; }), std::runtime_error);
+        REQUIRE_THROWS_AS(root->AddLeaf([](TP&, MS&) { return 0; }), std::runtime_error);
+        REQUIRE_THROWS_AS(root->Decorate([](TP&, MS&) { return 0; }), std::runtime_error);
+        REQUIRE_THROWS_AS(root->SetLoops(2), std::runtime_error);
+        REQUIRE_THROWS_AS(ctx.DestroyAllNodes(), std::runtime_error);
+    }
+
+    SECTION("Are required by UpdateAll") {
+        ExecutorBinding<TP> binding = { &exec, &vec };
+        TreeThreadPool pool(2);
+        REQUIRE_THROWS_AS(UpdateAll(pool, &binding, 1, 0), std::runtime_error);
+        ctx.Freeze();
+        UpdateAll(pool, &binding, 1, 0);
+        REQUIRE(vec.size() > 0);
+    }
+}
@@ -0,0 +1,79 @@
+#include "BehaviorTreePool.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+TEST_CASE("Compiled tree depth") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("Nested branches") {
+        Branch<TP>* root = ctx.CreateSequence()
+            ->Decorate([](TP&, MS&) { return 1; })
+            ->AddLeaf([](TP&, MS&) { return 0; })
+            ->AddSelector([](Branch<TP>* builder) { builder
+                ->Decorate([](TP&, MS&) { return 1; })
+                ->Decorate([](TP&, MS&) { return 1; })
+                ->AddLeaf([](TP&, MS&) { return 0; })
+            ;})
+        ;
+        auto tree = ctx.Compile(root);
+        REQUIRE(tree->MaxNodeDepth() == 3);
+        REQUIRE(tree->MaxDecoratorDepth() == 3);
+    }
+
+    SECTION("Recursive trees are unbounded") {
+        Branch<TP>* root = ctx.CreateSelector();
+        root->AddSequence([=](Branch<TP>* builder) { builder->AddNode(root); });
+        REQUIRE(ctx.Compile(root)->MaxNodeDepth() == CompiledTree<TP>::UNBOUNDED);
+        REQUIRE_THROWS_AS(ExecutorPool<TP>(ctx.Compile(root), 4), std::runtime_error);
+    }
+}
+
+TEST_CASE("Executor pools") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->Decorate([](TP& v, MS&) { v.push_back(0); return 1; })
+        ->AddSequence([](Branch<TP>* builder) { builder
+            ->Decorate([](TP& v, MS&) { v.push_back(1); return 2; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(2); return v.size() % 5 == 0 ? Result::SUCCESS : 1; })
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.push_back(3); return Result::SUCCESS; })
+    ;
+    auto tree = ctx.Compile(root);
+
+    SECTION("Behave like standalone executors") {
+        ExecutorPool<TP> pool(tree, 8);
+        TreeExecutor<TP> standalone(tree);
+        auto handle = pool.Create();
+        TP pooledOut;
+        TP standaloneOut;
+        for (uint64_t now = 0; now < 100; ++now)
+        {
+            pool.Update(handle, pooledOut, now);
+            standalone.Update(standaloneOut, now);
+        }
+        REQUIRE(pooledOut == standaloneOut);
+    }
+
+    SECTION("Reuse destroyed slots") {
+        ExecutorPool<TP> pool(tree, 2);
+        auto a = pool.Create();
+        auto b = pool.Create();
+        REQUIRE(pool.Size() == 2);
+        REQUIRE_THROWS_AS(pool.Create(), std::runtime_error);
+
+        TP vec;
+        pool.Update(a, vec, 0);
+        REQUIRE(pool.Get(a).NodeStackDepth() == 3);
+        pool.Destroy(a);
+        auto c = pool.Create();
+        REQUIRE(c == a);
+        REQUIRE(pool.Get(c).NodeStackDepth() == 0);
+        REQUIRE(pool.Size() == 2);
+        pool.Destroy(b);
+        pool.Destroy(c);
+        REQUIRE(pool.Size() == 0);
+    }
+}
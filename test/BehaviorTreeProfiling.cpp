@@ -0,0 +1,58 @@
+// Built into its own executable with BT_PROFILING defined
+#include "BehaviorTree.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+TEST_CASE("Profiling counters") {
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterLeaf("wait", [](TP& v, MS&) { v.push_back(0); return v.size() % 2 == 0 ? Result::SUCCESS : 1; });
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddLeaf("wait")
+        ->AddLeaf([](TP& v, MS&) { v.push_back(1); return Result::FAILURE; }, [](Leaf<TP>* leaf) { leaf
+            ->Decorate([](TP&, MS&) { return Result::SUCCESS; })
+        ;})
+    ;
+
+    TreeExecutor<TP> first(&ctx, root);
+    TreeExecutor<TP> second(&ctx, root);
+    TP v1, v2;
+    for (uint64_t i = 0; i < 4; ++i)
+    {
+        first.Update(v1, i);
+        second.Update(v2, i);
+    }
+
+    ProfileSnapshot snapshot = ctx.Profile();
+    REQUIRE(snapshot.m_trees.size() == 1);
+    REQUIRE(snapshot.m_trees[0].m_root == root);
+    REQUIRE(snapshot.m_trees[0].m_updates == 8);
+    REQUIRE(snapshot.m_trees[0].m_traversals > 0);
+    REQUIRE(snapshot.m_nodes.size() == 3);
+
+    NodeProfile const& wait = snapshot.m_nodes[1];
+    REQUIRE(wait.m_name == "wait");
+    REQUIRE(wait.m_kind == NodeKind::LEAF);
+    REQUIRE(wait.m_calls == wait.m_successes + wait.m_delays);
+    REQUIRE(wait.m_delays > 0);
+    REQUIRE(wait.m_maxCallNanos <= wait.m_callNanos);
+
+    NodeProfile const& failing = snapshot.m_nodes[2];
+    REQUIRE(failing.m_name == "");
+    REQUIRE(failing.m_failures == failing.m_calls);
+    REQUIRE(failing.m_decoratorCalls == failing.m_visits);
+
+    // ranking the most expensive nodes
+    std::sort(snapshot.m_nodes.begin(), snapshot.m_nodes.end(), [](NodeProfile const& a, NodeProfile const& b) {
+        return a.m_callNanos + a.m_decoratorNanos > b.m_callNanos + b.m_decoratorNanos;
+    });
+    REQUIRE(snapshot.m_nodes.back().m_kind == NodeKind::SEQUENCE);
+
+    ctx.ResetProfile();
+    REQUIRE(ctx.Profile().m_trees[0].m_updates == 0);
+    REQUIRE(ctx.Profile().m_nodes[1].m_calls == 0);
+}
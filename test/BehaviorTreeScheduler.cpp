@@ -0,0 +1,450 @@
+#include "BehaviorTreeScheduler.h"
+#include "BehaviorTreeTrace.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+static Branch<TP>* BuildAgent(BehaviorTreeContext<TP>& ctx, uint32_t id)
+{
+    return ctx.CreateSequence()
+        ->Decorate([=](TP& v, MS&) { v.push_back(100 + id); return int(3 + id % 5); })
+        ->AddLeaf([=](TP& v, MS&) { v.push_back(id); return int(1 + id % 7); })
+        ->AddLeaf([=](TP& v, MS&) { v.push_back(id); return Result::SUCCESS; })
+        ->AddLeaf([=](TP& v, MS&) { v.push_back(id); return v.size() % 3 == 0 ? int(id % 11) : int(Result::SUCCESS); })
+    ;
+}
+
+TEST_CASE("Scheduler matches updating every frame") {
+    constexpr uint32_t AGENTS = 64;
+    BehaviorTreeContext<TP> ctx;
+    std::vector<TreeExecutor<TP>> polled;
+    std::vector<TreeExecutor<TP>> scheduled;
+    for (uint32_t i = 0; i < AGENTS; ++i)
+    {
+        Branch<TP>* root = BuildAgent(ctx, i);
+        polled.emplace_back(&ctx, root);
+        scheduled.emplace_back(&ctx, root);
+    }
+
+    std::vector<TP> polledOut(AGENTS);
+    std::vector<TP> scheduledOut(AGENTS);
+    TreeScheduler<TP> scheduler;
+    for (uint32_t i = 0; i < AGENTS; ++i)
+    {
+        scheduler.Add(&scheduled[i], scheduledOut[i]);
+    }
+
+    for (uint64_t now = 0; now < 500; now += 1 + now % 3)
+    {
+        for (uint32_t i = 0; i < AGENTS; ++i)
+        {
+            polled[i].Update(polledOut[i], now);
+        }
+        scheduler.Tick(now);
+    }
+    REQUIRE(polledOut == scheduledOut);
+}
+
+TEST_CASE("Scheduler skips idle executors") {
+    BehaviorTreeContext<TP> ctx;
+    Leaf<TP>* leaf = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return 1000; });
+    std::vector<TreeExecutor<TP>> executors(1000, TreeExecutor<TP>(&ctx, leaf));
+    TP vec;
+    TreeScheduler<TP> scheduler;
+    for (TreeExecutor<TP>& executor : executors)
+    {
+        scheduler.Add(&executor, vec);
+    }
+
+    REQUIRE(scheduler.Tick(0) == 1000);
+    size_t updated = 0;
+    for (uint64_t now = 1; now < 1000; ++now)
+    {
+        updated += scheduler.Tick(now);
+    }
+    REQUIRE(updated == 0);
+    REQUIRE(scheduler.Tick(1000) == 1000);
+    REQUIRE(vec.size() == 2000);
+}
+
+TEST_CASE("Scheduler handles large time jumps") {
+    BehaviorTreeContext<TP> ctx;
+    Leaf<TP>* leaf = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return 5000; });
+    TreeExecutor<TP> exec(&ctx, leaf);
+    TP vec;
+    TreeScheduler<TP> scheduler(uint64_t(1) << 40);
+    scheduler.Add(&exec, vec);
+
+    uint64_t now = uint64_t(1) << 40;
+    REQUIRE(scheduler.Tick(now) == 1);
+    REQUIRE(scheduler.Tick(now + 4999) == 0);
+    REQUIRE(scheduler.Tick(now + 5000) == 1);
+    REQUIRE(scheduler.Tick(now + (uint64_t(1) << 50)) == 1);
+    REQUIRE(vec.size() == 3);
+}
+
+TEST_CASE("Scheduler remove and wake") {
+    BehaviorTreeContext<TP> ctx;
+    Leaf<TP>* leaf = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return 100; });
+    TreeExecutor<TP> exec1(&ctx, leaf);
+    TreeExecutor<TP> exec2(&ctx, leaf);
+    TP vec1;
+    TP vec2;
+    TreeScheduler<TP> scheduler;
+    auto handle1 = scheduler.Add(&exec1, vec1);
+    scheduler.Add(&exec2, vec2);
+    scheduler.Tick(0);
+
+    scheduler.Wake(handle1);
+    REQUIRE(scheduler.Tick(1) == 1);
+
+    scheduler.Remove(handle1);
+    REQUIRE(scheduler.Size() == 1);
+    REQUIRE(scheduler.Tick(100) == 1);
+    REQUIRE(vec1 == TP({ 0 }));
+    REQUIRE(vec2 == TP({ 0,0 }));
+}
+
+TEST_CASE("Scheduler wakes notified executors") {
+    BehaviorTreeContext<TP> ctx;
+    TreeEventId alarm = ctx.Callbacks().RegisterEvent("alarm");
+    Leaf<TP>* leaf = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return 1000; })
+        ->DecorateOn("alarm", [](TP& v, MS&) { v.push_back(1); return Result::SUCCESS; })
+    ;
+    std::vector<TreeExecutor<TP>> executors(100, TreeExecutor<TP>(&ctx, leaf));
+    TP vec;
+    TreeScheduler<TP> scheduler;
+    std::vector<TreeScheduler<TP>::Handle> handles;
+    for (TreeExecutor<TP>& executor : executors)
+    {
+        handles.push_back(scheduler.Add(&executor, vec));
+    }
+
+    REQUIRE(scheduler.Tick(0) == 100);
+    REQUIRE(scheduler.Tick(10) == 0);
+    scheduler.Notify(handles[3], alarm);
+    scheduler.Notify(handles[7], alarm);
+    REQUIRE(scheduler.Tick(11) == 2);
+    REQUIRE(scheduler.Tick(999) == 0);
+    REQUIRE(std::count(vec.begin(), vec.end(), 1) == 102);
+}
+
+TEST_CASE("Scheduler honors tick intervals") {
+    BehaviorTreeContext<TP> ctx;
+    // always running, so it would be updated on every tick
+    Leaf<TP>* leaf = ctx.CreateLeaf([](TP& v, MS&) { v.push_back(0); return 0; });
+    std::vector<TreeExecutor<TP>> executors(100, TreeExecutor<TP>(&ctx, leaf));
+    TP vec;
+    TreeScheduler<TP> scheduler;
+    std::vector<TreeScheduler<TP>::Handle> handles;
+    for (TreeExecutor<TP>& executor : executors)
+    {
+        handles.push_back(scheduler.Add(&executor, vec));
+    }
+    for (size_t i = 0; i < 90; ++i)
+    {
+        scheduler.SetTickInterval(handles[i], 10);
+    }
+
+    size_t updated = 0;
+    for (uint64_t now = 0; now < 100; ++now)
+    {
+        updated += scheduler.Tick(now);
+    }
+    REQUIRE(updated == 90 * 10 + 10 * 100);
+    REQUIRE(vec.size() == updated);
+
+    scheduler.SetTickInterval(handles[0], 0);
+    REQUIRE(scheduler.Tick(100) == 100);
+    scheduler.SetTickInterval(handles[1], 0);
+    REQUIRE(scheduler.Tick(101) == 12);
+}
+
+TEST_CASE("Scheduler splits a frame budget") {
+    BehaviorTreeContext<TP> ctx;
+    // enters 7 children per run, then waits
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddSequence([](Branch<TP>* builder) { builder
+            ->SetLoops(4)
+            ->AddLeaf([](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; })
+        ;})
+        ->AddLeaf([](TP& v, MS&) { v.push_back(1); return 1000; })
+    ;
+    std::vector<TreeExecutor<TP>> executors(10, TreeExecutor<TP>(&ctx, root));
+    std::vector<TP> vecs(10);
+    TreeScheduler<TP> scheduler;
+    for (size_t i = 0; i < executors.size(); ++i)
+    {
+        scheduler.Add(&executors[i], vecs[i]);
+    }
+
+    auto suspended = [&]() {
+        return std::count_if(executors.begin(), executors.end(), [](TreeExecutor<TP> const& e) { return e.IsSuspended(); });
+    };
+    auto finished = [&]() {
+        return std::count_if(vecs.begin(), vecs.end(), [](TP const& v) { return v.size() == 5; });
+    };
+
+    UpdateBudget frame;
+    frame.m_transitions = 20;
+    REQUIRE(scheduler.Tick(0, frame) == 3);
+    REQUIRE(frame.m_transitions == 0);
+    REQUIRE(finished() == 2);
+    REQUIRE(suspended() == 1);
+
+    // the suspended executor finishes first, the others get at most 4 each
+    frame.m_transitions = 12;
+    REQUIRE(scheduler.Tick(1, frame, 4) == 4);
+    REQUIRE(finished() == 3);
+    REQUIRE(suspended() == 3);
+
+    for (uint64_t now = 2; now < 10; ++now)
+    {
+        frame.m_transitions = 20;
+        scheduler.Tick(now, frame);
+    }
+    for (TP const& vec : vecs)
+    {
+        REQUIRE(vec == TP({ 0,0,0,0,1 }));
+    }
+}
+
+// agents keep their id as the first element of their context
+static Branch<TP>* BuildBatchedAgent(BehaviorTreeContext<TP>& ctx, BatchLeafCallback<TP> batched)
+{
+    return ctx.CreateSequence()
+        ->Decorate([](TP& v, MS&) { v.push_back(100 + v[0]); return int(2 + v[0] % 3); })
+        ->AddBatchLeaf(batched)
+        ->AddLeaf([](TP& v, MS&) { v.push_back(v[0]); return int(1 + v[0] % 5); })
+        ->AddMultiplexer([](TP& v, MS&) { return v.size() % 4 == 0 ? int(Result::SUCCESS) : 2; }, [&](Multiplexer<TP>* builder) { builder
+            ->AddSequence([&](Branch<TP>* builder) { builder
+                ->AddBatchLeaf(batched)
+                ->AddLeaf([](TP& v, MS&) { v.push_back(v[0]); return Result::SUCCESS; })
+            ;})
+        ;})
+    ;
+}
+
+TEST_CASE("Scheduler batches leaves") {
+    constexpr uint32_t AGENTS = 64;
+    size_t largest = 0;
+    BatchLeafCallback<TP> batched = [&](size_t count, TP* const* contexts, MS* const*, int* results) {
+        largest = std::max(largest, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            TP& v = *contexts[i];
+            v.push_back(1000 + v[0]);
+            results[i] = v.size() % 3 == 0 ? int(1 + v[0] % 4) : int(Result::SUCCESS);
+        }
+    };
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = BuildBatchedAgent(ctx, batched);
+
+    SECTION("Same transitions as unbatched updates") {
+        std::vector<TreeExecutor<TP>> polled(AGENTS, TreeExecutor<TP>(&ctx, root));
+        std::vector<TreeExecutor<TP>> scheduled(AGENTS, TreeExecutor<TP>(&ctx, root));
+        std::vector<TP> polledOut(AGENTS);
+        std::vector<TP> scheduledOut(AGENTS);
+        TreeScheduler<TP> scheduler;
+        scheduler.SetLeafBatching(true);
+        for (uint32_t i = 0; i < AGENTS; ++i)
+        {
+            polledOut[i] = { i };
+            scheduledOut[i] = { i };
+            scheduler.Add(&scheduled[i], scheduledOut[i]);
+        }
+
+        for (uint64_t now = 0; now < 200; ++now)
+        {
+            for (uint32_t i = 0; i < AGENTS; ++i)
+            {
+                polled[i].Update(polledOut[i], now);
+            }
+            largest = 0;
+            scheduler.Tick(now);
+            if (now == 0)
+            {
+                REQUIRE(largest == AGENTS);
+            }
+        }
+        REQUIRE(polledOut == scheduledOut);
+    }
+
+    SECTION("Executors wait for the batch to run") {
+        TreeExecutor<TP> first(&ctx, root);
+        TreeExecutor<TP> second(&ctx, root);
+        TraceBuffer trace(256);
+        first.SetTrace(&trace);
+        TP firstOut = { 1 };
+        TP secondOut = { 2 };
+        LeafBatch<TP> batch;
+        UpdateBudget budget;
+        REQUIRE(first.Update(firstOut, 0, budget, batch));
+        REQUIRE(second.Update(secondOut, 0, budget, batch));
+        REQUIRE(first.IsWaitingOnBatch());
+        REQUIRE(batch.Size() == 2);
+        REQUIRE(firstOut == TP({ 1, 101 }));
+        batch.Run();
+        REQUIRE(largest == 2);
+        REQUIRE(firstOut == TP({ 1, 101, 1001 }));
+        REQUIRE_FALSE(first.Update(firstOut, 0, budget, batch));
+        REQUIRE_FALSE(first.IsWaitingOnBatch());
+        // the batched result is a delay, which the leaf waits on as usual
+        REQUIRE(first.NextUpdateTime() == 2);
+        REQUIRE(firstOut == TP({ 1, 101, 1001 }));
+
+        // waiting is invisible in traces, which replay as plain updates
+        for (uint64_t now = 1; now < 20; ++now)
+        {
+            if (first.Update(firstOut, now, budget, batch))
+            {
+                batch.Run();
+                first.Update(firstOut, now, budget, batch);
+            }
+        }
+        std::vector<TraceEvent> events = trace.Events();
+        REQUIRE(TraceReplay<TP>::Replay(*ctx.Compile(root), events.data(), events.size()).Matches());
+    }
+}
+
+TEST_CASE("Scheduler batches registered batch leaves") {
+    constexpr uint32_t AGENTS = 8;
+    size_t calls = 0;
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterLeaf("mark", [](TP& v, MS&) { v.push_back(100); return Result::SUCCESS; });
+    ctx.Callbacks().RegisterBatchLeaf("count", [&](size_t count, TP* const* contexts, MS* const*, int* results) {
+        calls++;
+        for (size_t i = 0; i < count; ++i)
+        {
+            contexts[i]->push_back(uint32_t(contexts[i]->size()));
+            results[i] = 1;
+        }
+    });
+    auto build = [&]() {
+        return ctx.CreateSequence()
+            ->AddLeaf("mark")
+            ->AddLeaf("count")
+        ;
+    };
+    Branch<TP>* oldRoot = build();
+    std::vector<TreeExecutor<TP>> executors(AGENTS, TreeExecutor<TP>(&ctx, oldRoot));
+    std::vector<TP> out(AGENTS);
+    TreeScheduler<TP> scheduler;
+    scheduler.SetLeafBatching(true);
+    for (uint32_t i = 0; i < AGENTS; ++i)
+    {
+        scheduler.Add(&executors[i], out[i]);
+    }
+    scheduler.Tick(0);
+    REQUIRE(calls == 1);
+
+    // reloaded trees keep the running leaf and still share one call
+    Branch<TP>* newRoot = build();
+    scheduler.ReplaceTree(oldRoot, newRoot, AGENTS);
+    scheduler.Tick(1);
+    REQUIRE(calls == 2);
+    for (uint32_t i = 0; i < AGENTS; ++i)
+    {
+        REQUIRE(executors[i].RootNode() == newRoot);
+        REQUIRE(out[i] == TP({ 100, 1, 2 }));
+    }
+}
+
+TEST_CASE("Scheduler replaces trees incrementally") {
+    constexpr uint32_t AGENTS = 10;
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterLeafFactory("push", [](CallbackArgs const& args) {
+        uint32_t value = uint32_t(args.at(0));
+        return [value](TP& v, MS&) { v.push_back(value); return Result::SUCCESS; };
+    });
+    // keeps running until the output holds five values
+    ctx.Callbacks().RegisterLeaf("wait", [](TP& v, MS&) {
+        v.push_back(2);
+        return v.size() < 5 ? 1 : int(Result::SUCCESS);
+    });
+    auto build = [&](uint32_t tag) {
+        return ctx.CreateSequence()
+            ->AddLeaf("push", { double(tag + 1) })
+            ->AddLeaf("wait")
+            ->AddLeaf("push", { double(tag + 3) })
+        ;
+    };
+    Branch<TP>* oldRoot = build(0);
+    Branch<TP>* newRoot = build(100);
+    Branch<TP>* otherRoot = build(200);
+    std::vector<TreeExecutor<TP>> executors(AGENTS, TreeExecutor<TP>(&ctx, oldRoot));
+    executors.back() = TreeExecutor<TP>(&ctx, otherRoot);
+    std::vector<TP> out(AGENTS);
+    TreeScheduler<TP> scheduler;
+    for (uint32_t i = 0; i < AGENTS; ++i)
+    {
+        scheduler.Add(&executors[i], out[i]);
+    }
+    scheduler.Tick(0);
+
+    scheduler.ReplaceTree(oldRoot, newRoot, 4);
+    REQUIRE(scheduler.IsReplacingTree());
+    for (uint64_t now = 1; now <= 3; ++now)
+    {
+        scheduler.Tick(now);
+        size_t replaced = std::count_if(executors.begin(), executors.end(), [&](TreeExecutor<TP> const& e) { return e.RootNode() == newRoot; });
+        REQUIRE(replaced == std::min<size_t>(now * 4, AGENTS - 1));
+    }
+    REQUIRE_FALSE(scheduler.IsReplacingTree());
+    REQUIRE(executors.back().RootNode() == otherRoot);
+
+    // running leaves continue in the new tree instead of starting over
+    REQUIRE(out[0] == TP({ 1, 2, 2, 2, 2, 103 }));
+    REQUIRE(out[8] == TP({ 1, 2, 2, 2, 2, 103 }));
+    REQUIRE(out[9] == TP({ 201, 2, 2, 2, 2, 203 }));
+}
+
+TEST_CASE("Scheduler keeps executors after a throwing update") {
+    BehaviorTreeContext<TP> ctx;
+    bool thrown = false;
+    Branch<TP>* throwing = ctx.CreateSequence()
+        ->AddLeaf([&](TP& v, MS&) {
+            if (!thrown)
+            {
+                thrown = true;
+                throw std::runtime_error("leaf failed");
+            }
+            v.push_back(1);
+            return 1;
+        })
+    ;
+    Branch<TP>* batched = ctx.CreateSequence()
+        ->AddBatchLeaf([](size_t count, TP* const* contexts, MS* const*, int* results) {
+            for (size_t i = 0; i < count; ++i)
+            {
+                contexts[i]->push_back(2);
+                results[i] = 1;
+            }
+        })
+    ;
+    TreeExecutor<TP> first(&ctx, batched);
+    TreeExecutor<TP> second(&ctx, throwing);
+    TreeExecutor<TP> third(&ctx, batched);
+    TP firstOut;
+    TP secondOut;
+    TP thirdOut;
+    TreeScheduler<TP> scheduler;
+    scheduler.SetLeafBatching(true);
+    scheduler.Add(&first, firstOut);
+    scheduler.Add(&second, secondOut);
+    scheduler.Add(&third, thirdOut);
+
+    REQUIRE_THROWS_AS(scheduler.Tick(0), std::runtime_error);
+    REQUIRE(firstOut.empty());
+    for (uint64_t now = 1; now < 3; ++now)
+    {
+        scheduler.Tick(now);
+    }
+    REQUIRE(firstOut == TP({ 2, 2 }));
+    REQUIRE(secondOut == TP({ 1, 1 }));
+    REQUIRE(thirdOut == TP({ 2, 2 }));
+}
@@ -0,0 +1,331 @@
+#include "BehaviorTreeSerialization.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+static Node<TP,MS,MS>* BuildNamedTree(BehaviorTreeContext<TP>& ctx)
+{
+    CallbackRegistry<TP>& callbacks = ctx.Callbacks();
+    callbacks.RegisterLeaf("push0", [](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; });
+    callbacks.RegisterLeaf("push1", [](TP& v, MS&) { v.push_back(1); return v.size() % 3 == 0 ? Result::FAILURE : 2; });
+    callbacks.RegisterLeaf("mux", [](TP& v, MS&) { v.push_back(9); return v.size() > 12 ? Result::SUCCESS : 0; });
+    callbacks.RegisterDecorator("twice", [](TP& v, MS&) { v.push_back(5); return 2; });
+    callbacks.RegisterLeafFactory("pushArg", [](CallbackArgs const& args) {
+        uint32_t value = uint32_t(args.at(0));
+        return [=](TP& v, MS&) { v.push_back(value); return Result::SUCCESS; };
+    });
+    return ctx.CreateMultiplexer("mux")
+        ->DecorateOn("alarm", "twice")
+        ->AddSelector([](Branch<TP>* builder) { builder
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->Decorate("twice")
+                ->AddLeaf("push1")
+                ->AddLeaf("push0")
+            ;})
+            ->AddLeaf("push0")
+        ;})
+        ->AddLeaf("pushArg", { 42 })
+        ->AddLeaf("push1")
+    ;
+}
+
+static TP Run(TreeExecutor<TP>& executor, size_t updates, TreeEventId alarm)
+{
+    TP v;
+    for (size_t i = 0; i < updates; ++i)
+    {
+        if (i == 1)
+        {
+            executor.Notify(alarm);
+        }
+        executor.Update(v, i);
+    }
+    return v;
+}
+
+TEST_CASE("Serialized trees") {
+    BehaviorTreeContext<TP> ctx;
+    Node<TP,MS,MS>* root = BuildNamedTree(ctx);
+    auto compiled = ctx.Compile(root);
+    std::vector<uint8_t> data = TreeSerializer<TP>::Save(*compiled);
+
+    TreeEventId alarm = ctx.Callbacks().GetEvent("alarm");
+    TreeExecutor<TP> original(&ctx, root);
+    TP expected = Run(original, 20, alarm);
+
+    SECTION("Round trip") {
+        auto loaded = TreeSerializer<TP>::Load(data.data(), data.size(), ctx.Callbacks());
+        REQUIRE(loaded->NodeCount() == compiled->NodeCount());
+        REQUIRE(loaded->MaxNodeDepth() == compiled->MaxNodeDepth());
+        TreeExecutor<TP> executor(loaded);
+        REQUIRE(Run(executor, 20, alarm) == expected);
+    }
+
+    SECTION("Unaligned buffers are copied") {
+        std::vector<uint8_t> shifted(data.size() + 1);
+        std::copy(data.begin(), data.end(), shifted.begin() + 1);
+        auto loaded = TreeSerializer<TP>::Load(shifted.data() + 1, data.size(), ctx.Callbacks());
+        shifted.clear();
+        TreeExecutor<TP> executor(loaded);
+        REQUIRE(Run(executor, 20, alarm) == expected);
+    }
+
+    SECTION("Mapped files") {
+        std::string path = "BehaviorTreeSerialization.bt";
+        TreeSerializer<TP>::SaveFile(path, *compiled);
+        {
+            auto loaded = TreeSerializer<TP>::LoadFile(path, ctx.Callbacks());
+            TreeExecutor<TP> executor(loaded);
+            REQUIRE(Run(executor, 20, alarm) == expected);
+        }
+        std::remove(path.c_str());
+    }
+
+    SECTION("Missing callbacks") {
+        CallbackRegistry<TP> empty;
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::Load(data.data(), data.size(), empty), std::runtime_error);
+    }
+
+    SECTION("Corrupt data") {
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::Load(data.data(), data.size() - 1, ctx.Callbacks()), std::runtime_error);
+        std::vector<uint8_t> corrupt = data;
+        corrupt[0] = 'X';
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::Load(corrupt.data(), corrupt.size(), ctx.Callbacks()), std::runtime_error);
+        corrupt = data;
+        // first child index of the root
+        corrupt[sizeof(TreeFileHeader) + sizeof(CompiledNode) * compiled->NodeCount()] = 0xff;
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::Load(corrupt.data(), corrupt.size(), ctx.Callbacks()), std::runtime_error);
+    }
+}
+
+TEST_CASE("Deep tree files load without recursing") {
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterLeaf("push0", [](TP& v, MS&) { v.push_back(0); return Result::SUCCESS; });
+    std::vector<uint8_t> data = TreeSerializer<TP>::Save(*ctx.Compile(ctx.CreateSequence()->AddLeaf("push0")));
+    auto align = [](std::vector<uint8_t>& out) { out.resize((out.size() + 7) / 8 * 8, 0); };
+
+    // a chain of sequences far deeper than the native stack allows to recurse through
+    constexpr uint32_t DEPTH = 1 << 20;
+    TreeFileHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    size_t tail = (sizeof(header) + 2 * sizeof(CompiledNode) + sizeof(uint32_t) + 7) / 8 * 8;
+    header.m_nodeCount = DEPTH + 1;
+    header.m_childCount = DEPTH;
+    std::vector<uint8_t> deep(reinterpret_cast<uint8_t const*>(&header), reinterpret_cast<uint8_t const*>(&header + 1));
+    align(deep);
+    for (uint32_t i = 0; i <= DEPTH; ++i)
+    {
+        CompiledNode node;
+        node.m_kind = i < DEPTH ? NodeKind::SEQUENCE : NodeKind::LEAF;
+        node.m_childBegin = i;
+        node.m_childEnd = i < DEPTH ? i + 1 : i;
+        node.m_callback = i < DEPTH ? CompiledNode::NO_CALLBACK : 0;
+        deep.insert(deep.end(), reinterpret_cast<uint8_t const*>(&node), reinterpret_cast<uint8_t const*>(&node + 1));
+    }
+    align(deep);
+    for (uint32_t i = 1; i <= DEPTH; ++i)
+    {
+        deep.insert(deep.end(), reinterpret_cast<uint8_t const*>(&i), reinterpret_cast<uint8_t const*>(&i + 1));
+    }
+    align(deep);
+    deep.insert(deep.end(), data.begin() + tail, data.end());
+
+    auto loaded = TreeSerializer<TP>::Load(deep.data(), deep.size(), ctx.Callbacks());
+    REQUIRE(loaded->MaxNodeDepth() == DEPTH + 1);
+}
+
+TEST_CASE("Unregistered callbacks cannot be serialized") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddLeaf([](TP&, MS&) { return Result::SUCCESS; })
+    ;
+    REQUIRE_THROWS_AS(TreeSerializer<TP>::Save(*ctx.Compile(root)), std::runtime_error);
+}
+
+TEST_CASE("Loaded trees batch registered batch leaves") {
+    BehaviorTreeContext<TP> ctx;
+    ctx.Callbacks().RegisterBatchLeaf("batched", [](size_t count, TP* const* contexts, MS* const*, int* results) {
+        for (size_t i = 0; i < count; ++i)
+        {
+            contexts[i]->push_back(uint32_t(count));
+            results[i] = Result::SUCCESS;
+        }
+    });
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddLeaf("batched")
+    ;
+    std::vector<uint8_t> data = TreeSerializer<TP>::Save(*ctx.Compile(root));
+    auto loaded = TreeSerializer<TP>::Load(data.data(), data.size(), ctx.Callbacks());
+    TreeExecutor<TP> first(loaded);
+    TreeExecutor<TP> second(loaded);
+    TP firstOut;
+    TP secondOut;
+    LeafBatch<TP> batch;
+    UpdateBudget budget;
+    first.Update(firstOut, 0, budget, batch);
+    second.Update(secondOut, 0, budget, batch);
+    REQUIRE(batch.Size() == 2);
+    batch.Run();
+    REQUIRE(firstOut == TP({ 2 }));
+    // without a batch it runs for a single executor
+    first.Update(firstOut, 0);
+    first.Update(firstOut, 1);
+    REQUIRE(firstOut == TP({ 2, 1 }));
+}
+
+static TP Continue(TreeExecutor<TP>& executor, uint64_t from, uint64_t to)
+{
+    TP v;
+    for (uint64_t i = from; i < to; ++i)
+    {
+        executor.Update(v, i);
+    }
+    return v;
+}
+
+TEST_CASE("Executor snapshots") {
+    BehaviorTreeContext<TP> ctx;
+    Node<TP,MS,MS>* root = BuildNamedTree(ctx);
+    auto compiled = ctx.Compile(root);
+    TreeEventId alarm = ctx.Callbacks().GetEvent("alarm");
+
+    TreeExecutor<TP> original(compiled);
+    Run(original, 5, alarm);
+    original.Notify(alarm);
+
+    SECTION("Restored executors continue where they were saved") {
+        std::vector<uint8_t> snapshot = TreeSerializer<TP>::SaveExecutor(original, 5);
+        TreeExecutor<TP> restored(compiled);
+        TreeSerializer<TP>::LoadExecutor(restored, snapshot.data(), snapshot.size(), 5);
+        REQUIRE(restored.NodeStackDepth() == original.NodeStackDepth());
+        REQUIRE(restored.NextUpdateTime() == original.NextUpdateTime());
+        REQUIRE(Continue(restored, 5, 30) == Continue(original, 5, 30));
+    }
+
+    SECTION("Timers are rebased") {
+        std::vector<uint8_t> snapshot = TreeSerializer<TP>::SaveExecutor(original, 5);
+        TreeExecutor<TP> restored(&ctx, root);
+        TreeSerializer<TP>::LoadExecutor(restored, snapshot.data(), snapshot.size(), 1000);
+        REQUIRE(Continue(restored, 1000, 1025) == Continue(original, 5, 30));
+    }
+
+    SECTION("Snapshots of other trees are rejected") {
+        std::vector<uint8_t> snapshot = TreeSerializer<TP>::SaveExecutor(original, 5);
+        BehaviorTreeContext<TP> other;
+        TreeExecutor<TP> executor(&other, other.CreateSequence()->AddLeaf([](TP&, MS&) { return 1; }));
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::LoadExecutor(executor, snapshot.data(), snapshot.size(), 5), std::runtime_error);
+        TreeExecutor<TP> restored(compiled);
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::LoadExecutor(restored, snapshot.data(), snapshot.size() - 1, 5), std::runtime_error);
+    }
+}
+
+TEST_CASE("Executor snapshots encode memory with a codec") {
+    using Memory = std::string;
+    using Serializer = TreeSerializer<TP,Memory>;
+    BehaviorTreeContext<TP,Memory> ctx;
+    Branch<TP,Memory>* root = ctx.CreateSequence()
+        ->AddLeaf([](TP& v, Memory& memory) {
+            memory += 'x';
+            v.push_back(uint32_t(memory.size()));
+            return memory.size() < 3 ? 1 : int(Result::SUCCESS);
+        })
+    ;
+    TreeExecutor<TP,Memory> original(&ctx, root);
+    TP v;
+    original.Update(v, 0);
+    original.Update(v, 1);
+    REQUIRE_THROWS_AS(Serializer::SaveExecutor(original, 1), std::runtime_error);
+
+    Serializer::MemoryCodec codec;
+    codec.m_saveLeaf = [](Memory const& memory, std::vector<uint8_t>& out) {
+        out.push_back(uint8_t(memory.size()));
+        out.insert(out.end(), memory.begin(), memory.end());
+    };
+    codec.m_loadLeaf = [](uint8_t const* data, size_t size, Memory& memory) {
+        if (size < 1 || size < 1 + size_t(data[0]))
+        {
+            throw std::runtime_error("truncated");
+        }
+        memory.assign(data + 1, data + 1 + data[0]);
+        return size_t(1 + data[0]);
+    };
+    std::vector<uint8_t> snapshot = Serializer::SaveExecutor(original, 1, codec);
+    TreeExecutor<TP,Memory> restored(&ctx, root);
+    Serializer::LoadExecutor(restored, snapshot.data(), snapshot.size(), 1, codec);
+    TP restoredOutput;
+    restored.Update(restoredOutput, 2);
+    REQUIRE(restoredOutput == TP({ 3 }));
+}
+
+TEST_CASE("Executor snapshots construct typed memory again") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddTypedLeaf<uint32_t>([](TP& v, uint32_t& step) {
+            v.push_back(++step);
+            return step < 3 ? 1 : int(Result::SUCCESS);
+        }, [](Leaf<TP>* builder) { builder
+            ->DecorateTyped<uint32_t>([](TP& v, uint32_t& evaluations) {
+                v.push_back(10 + ++evaluations);
+                return 1;
+            })
+        ;})
+    ;
+    TreeExecutor<TP> original(&ctx, root);
+    TP v;
+    original.Update(v, 0);
+    original.Update(v, 1);
+    std::vector<uint8_t> snapshot = TreeSerializer<TP>::SaveExecutor(original, 1);
+    TreeExecutor<TP> restored(&ctx, root);
+    TreeSerializer<TP>::LoadExecutor(restored, snapshot.data(), snapshot.size(), 1);
+    REQUIRE(restored.NodeMemory().Size() == 2 * sizeof(uint32_t));
+    REQUIRE(Continue(restored, 2, 3) == TP({ 11, 1 }));
+}
+
+TEST_CASE("Executor snapshots with inconsistent decorator stacks are rejected") {
+    BehaviorTreeContext<TP> ctx;
+    Branch<TP>* root = ctx.CreateSequence()
+        ->AddSequence([](Branch<TP>* builder) { builder
+            ->Decorate([](TP&, MS&) { return 5; })
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->Decorate([](TP&, MS&) { return 5; })
+                ->AddLeaf([](TP&, MS&) { return 3; })
+            ;})
+        ;})
+    ;
+    TreeExecutor<TP> original(&ctx, root);
+    TP v;
+    original.Update(v, 0);
+    std::vector<uint8_t> snapshot = TreeSerializer<TP>::SaveExecutor(original, 0);
+    // the four entries are followed by the decorators of the two inner sequences
+    size_t nodes = sizeof(TreeSnapshotHeader) + sizeof(TreeSnapshotExecutor);
+    size_t decorators = nodes + 4 * sizeof(TreeSnapshotNode);
+    REQUIRE(snapshot.size() == decorators + 2 * sizeof(TreeSnapshotDecorator));
+    TreeExecutor<TP> restored(&ctx, root);
+    std::vector<uint8_t> corrupt = snapshot;
+
+    SECTION("Entries owning decorators pushed after them") {
+        int32_t decoStackSize = 1;
+        std::memcpy(corrupt.data() + nodes + offsetof(TreeSnapshotNode, m_decoStackSize), &decoStackSize, sizeof(decoStackSize));
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::LoadExecutor(restored, corrupt.data(), corrupt.size(), 0), std::runtime_error);
+    }
+
+    SECTION("Decorators out of stack order") {
+        int32_t indices[] = { 2, 1 };
+        for (size_t i = 0; i < 2; ++i)
+        {
+            std::memcpy(corrupt.data() + decorators + i * sizeof(TreeSnapshotDecorator) + offsetof(TreeSnapshotDecorator, m_nodeStackIndex), &indices[i], sizeof(int32_t));
+        }
+        REQUIRE_THROWS_AS(TreeSerializer<TP>::LoadExecutor(restored, corrupt.data(), corrupt.size(), 0), std::runtime_error);
+    }
+
+    SECTION("Untouched snapshots still load") {
+        TreeSerializer<TP>::LoadExecutor(restored, corrupt.data(), corrupt.size(), 0);
+        REQUIRE(restored.NodeStackDepth() == 4);
+    }
+}
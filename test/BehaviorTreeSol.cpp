@@ -0,0 +1,82 @@
+#include "BehaviorTreeScheduler.h"
+#include "BehaviorTreeSerialization.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using MS = std::monostate;
+
+struct LuaAgent
+{
+    int m_value = 0;
+};
+
+static void RunScheduler(std::vector<TreeExecutor<LuaAgent>>& executors, std::vector<LuaAgent>& agents, uint64_t now)
+{
+    TreeScheduler<LuaAgent> scheduler;
+    scheduler.SetLeafBatching(true);
+    for (size_t i = 0; i < executors.size(); ++i)
+    {
+        scheduler.Add(&executors[i], agents[i]);
+    }
+    scheduler.Tick(now);
+}
+
+TEST_CASE("Lua batch leaves") {
+    constexpr size_t AGENTS = 16;
+    sol::state lua;
+    lua.open_libraries(sol::lib::base);
+    lua.new_usertype<LuaAgent>("LuaAgent", "value", &LuaAgent::m_value);
+    BehaviorTreeContext<LuaAgent> ctx;
+    LuaRegisterBehaviorTree<LuaAgent, MS, MS>(lua, "");
+    lua["ctx"] = &ctx;
+    lua.script(R"(
+        calls = 0
+        function grow(agents, memories)
+            calls = calls + 1
+            local results = {}
+            for i, agent in ipairs(agents) do
+                agent.value = agent.value + #agents
+                results[i] = -1
+            end
+            return results
+        end
+    )");
+    std::vector<LuaAgent> agents(AGENTS);
+
+    SECTION("One call per batch") {
+        lua.script("root = ctx:CreateSequence():AddBatchLeaf(grow)");
+        Branch<LuaAgent>* root = lua["root"];
+        std::vector<TreeExecutor<LuaAgent>> executors(AGENTS, TreeExecutor<LuaAgent>(&ctx, root));
+        RunScheduler(executors, agents, 0);
+        REQUIRE(lua["calls"].get<int>() == 1);
+        for (LuaAgent const& agent : agents)
+        {
+            REQUIRE(agent.m_value == int(AGENTS));
+        }
+        // a batch of one without the scheduler
+        TreeExecutor<LuaAgent> single(&ctx, root);
+        single.Update(agents[0], 1);
+        REQUIRE(lua["calls"].get<int>() == 2);
+        REQUIRE(agents[0].m_value == int(AGENTS) + 1);
+    }
+
+    SECTION("Registered batch leaves") {
+        lua.script(R"(
+            ctx:RegisterBatchLeaf("grow", grow)
+            root = ctx:CreateSequence():AddLeaf("grow")
+        )");
+        Branch<LuaAgent>* root = lua["root"];
+        std::vector<TreeExecutor<LuaAgent>> executors(AGENTS, TreeExecutor<LuaAgent>(&ctx, root));
+        RunScheduler(executors, agents, 0);
+        REQUIRE(lua["calls"].get<int>() == 1);
+        REQUIRE(agents.back().m_value == int(AGENTS));
+        REQUIRE_NOTHROW(TreeSerializer<LuaAgent>::Save(*ctx.Compile(root)));
+    }
+
+    SECTION("Errors are rethrown") {
+        lua.script("root = ctx:CreateSequence():AddBatchLeaf(function(agents, memories) error('broken') end)");
+        Branch<LuaAgent>* root = lua["root"];
+        TreeExecutor<LuaAgent> executor(&ctx, root);
+        REQUIRE_THROWS_AS(executor.Update(agents[0], 0), std::runtime_error);
+    }
+}
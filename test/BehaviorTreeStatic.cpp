@@ -0,0 +1,373 @@
+#include "BehaviorTreeStatic.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <type_traits>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+template <uint32_t Value, int Result>
+static int Push(TP& v, MS&)
+{
+    v.push_back(Value);
+    return Result;
+}
+
+// fails whenever the output reaches a multiple of Period
+template <uint32_t Value, size_t Period, int Otherwise>
+static int PushPeriodic(TP& v, MS&)
+{
+    v.push_back(Value);
+    return v.size() % Period == 0 ? int(Result::FAILURE) : Otherwise;
+}
+
+template <int Result>
+static int Return(TP&, MS&)
+{
+    return Result;
+}
+
+// waits once, then succeeds with the third output
+static int PushUntilThird(TP& v, MS&)
+{
+    v.push_back(1);
+    return v.size() == 3 ? Result::SUCCESS : 1;
+}
+
+// fails the first time, then succeeds
+static int PushFailFirst(TP& v, MS&)
+{
+    v.push_back(0);
+    return v.size() > 1 ? Result::SUCCESS : Result::FAILURE;
+}
+
+template <size_t Limit>
+static int Until(TP& v, MS&)
+{
+    v.push_back(9);
+    return v.size() >= Limit ? Result::SUCCESS : 1;
+}
+
+// Runs the dynamic and the static tree side by side at the given times and
+// returns their output
+template <typename Root, typename LC = MS, typename DC = LC>
+static TP RequireSameAs(BehaviorTreeContext<TP,LC,DC>& ctx, Node<TP,LC,DC>* root, std::vector<uint64_t> const& times)
+{
+    TreeExecutor<TP,LC,DC> dynamic(&ctx, root);
+    StaticTreeExecutor<Root,TP,LC,DC> fixed;
+    TP expected;
+    TP actual;
+    for (uint64_t now : times)
+    {
+        dynamic.Update(expected, now);
+        fixed.Update(actual, now);
+        REQUIRE(actual == expected);
+    }
+    REQUIRE(expected.size() > 0);
+    return actual;
+}
+
+static std::vector<uint64_t> Times(uint64_t count)
+{
+    std::vector<uint64_t> times;
+    uint64_t now = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        times.push_back(now);
+        // repeat some times and skip ahead others
+        now += (i * 7) % 4;
+    }
+    return times;
+}
+
+TEST_CASE("Static leaves") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("Without delay") {
+        RequireSameAs<StaticLeaf<&Push<0,0>>>(ctx, ctx.CreateLeaf(&Push<0,0>), Times(20));
+    }
+
+    SECTION("With delay") {
+        RequireSameAs<StaticLeaf<&Push<0,3>>>(ctx, ctx.CreateLeaf(&Push<0,3>), Times(40));
+    }
+
+    SECTION("Ending the tree") {
+        RequireSameAs<StaticLeaf<&Push<0,Result::SUCCESS>>>(ctx, ctx.CreateLeaf(&Push<0,Result::SUCCESS>), Times(10));
+    }
+
+    SECTION("Called twice without delay") {
+        using Static = StaticLeaf<&Push<0,0>>;
+        REQUIRE(RequireSameAs<Static>(ctx, ctx.CreateLeaf(&Push<0,0>), { 0,0 }) == TP({ 0,0 }));
+    }
+
+    SECTION("Delayed and called twice without delay") {
+        using Static = StaticLeaf<&Push<0,1>>;
+        REQUIRE(RequireSameAs<Static>(ctx, ctx.CreateLeaf(&Push<0,1>), { 0,0 }) == TP({ 0 }));
+    }
+
+    SECTION("Delayed and called twice with delay") {
+        using Static = StaticLeaf<&Push<0,1>>;
+        REQUIRE(RequireSameAs<Static>(ctx, ctx.CreateLeaf(&Push<0,1>), { 0,1 }) == TP({ 0,0 }));
+    }
+
+    SECTION("Delayed and called twice with overflowing delay") {
+        using Static = StaticLeaf<&Push<0,1>>;
+        REQUIRE(RequireSameAs<Static>(ctx, ctx.CreateLeaf(&Push<0,1>), { 0,4 }) == TP({ 0,0 }));
+    }
+}
+
+TEST_CASE("Static branches") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("Sequences and selectors") {
+        using Static = StaticSequence<
+            StaticLeaf<&Push<0,1>>,
+            StaticSelector<
+                StaticLeaf<&PushPeriodic<1,3,Result::SUCCESS>>,
+                StaticLeaf<&Push<2,2>>
+            >,
+            StaticLeaf<&PushPeriodic<3,4,0>>
+        >;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddLeaf(&Push<0,1>)
+            ->AddSelector([](Branch<TP>* builder) { builder
+                ->AddLeaf(&PushPeriodic<1,3,Result::SUCCESS>)
+                ->AddLeaf(&Push<2,2>)
+            ;})
+            ->AddLeaf(&PushPeriodic<3,4,0>)
+        ;
+        RequireSameAs<Static>(ctx, root, Times(100));
+    }
+
+    SECTION("Sequence + Leaf(Success) + Leaf(1->Success)") {
+        using Static = StaticSequence<StaticLeaf<&Push<0,Result::SUCCESS>>, StaticLeaf<&PushUntilThird>>;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddLeaf(&Push<0,Result::SUCCESS>)
+            ->AddLeaf(&PushUntilThird)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0 }) == TP({ 0,1 }));
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 0,1 }));
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,1 }) == TP({ 0,1,1 }));
+        RequireSameAs<Static>(ctx, root, Times(20));
+    }
+
+    SECTION("Selector + Leaf(FAILURE->SUCCESS) + Leaf(SUCCESS)") {
+        using Static = StaticSelector<StaticLeaf<&PushFailFirst>, StaticLeaf<&Push<1,Result::SUCCESS>>>;
+        Branch<TP>* root = ctx.CreateSelector()
+            ->AddLeaf(&PushFailFirst)
+            ->AddLeaf(&Push<1,Result::SUCCESS>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0 }) == TP({ 0,1 }));
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 0,1,0 }));
+    }
+
+    SECTION("Loops and attempts") {
+        using Static = StaticSequence<
+            StaticBranch<BranchType::SEQUENCE, 25, 1, StaticLeaf<&Push<0,Result::SUCCESS>>>,
+            StaticBranch<BranchType::SELECTOR, 1, 5, StaticLeaf<&Push<1,Result::FAILURE>>>,
+            StaticBranch<BranchType::SEQUENCE, 3, 4, StaticLeaf<&PushPeriodic<2,5,1>>>
+        >;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->SetLoops(25)
+                ->AddLeaf(&Push<0,Result::SUCCESS>)
+            ;})
+            ->AddSelector([](Branch<TP>* builder) { builder
+                ->SetAttempts(5)
+                ->AddLeaf(&Push<1,Result::FAILURE>)
+            ;})
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->SetLoops(3)
+                ->SetAttempts(4)
+                ->AddLeaf(&PushPeriodic<2,5,1>)
+            ;})
+        ;
+        RequireSameAs<Static>(ctx, root, Times(100));
+    }
+}
+
+TEST_CASE("Static decorators") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("Without delay") {
+        using Static = StaticDecorated<StaticLeaf<&Return<0>>, &Push<0,0>>;
+        Leaf<TP>* root = ctx.CreateLeaf(&Return<0>)
+            ->Decorate(&Push<0,0>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 0,0 }));
+    }
+
+    SECTION("With delay") {
+        using Static = StaticDecorated<StaticLeaf<&Return<0>>, &Push<0,1>>;
+        Leaf<TP>* root = ctx.CreateLeaf(&Return<0>)
+            ->Decorate(&Push<0,1>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 0 }));
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,2 }) == TP({ 0,0 }));
+    }
+
+    SECTION("Leaf + decorator") {
+        using Static = StaticDecorated<StaticLeaf<&Push<0,0>>, &Push<1,0>>;
+        Leaf<TP>* root = ctx.CreateLeaf(&Push<0,0>)
+            ->Decorate(&Push<1,0>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 1,0,1,0 }));
+    }
+
+    SECTION("Leaf + decorator + decorator") {
+        using Static = StaticDecorated<StaticLeaf<&Push<0,0>>, &Push<1,0>, &Push<2,0>>;
+        Leaf<TP>* root = ctx.CreateLeaf(&Push<0,0>)
+            ->Decorate(&Push<1,0>)
+            ->Decorate(&Push<2,0>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 1,2,0,1,2,0 }));
+    }
+
+    SECTION("Deep decorators") {
+        using Static = StaticDecorated<
+            StaticSequence<StaticDecorated<StaticSequence<StaticLeaf<&Push<1,0>>>, &Push<0,0>>>,
+            &Push<2,0>
+        >;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->Decorate(&Push<0,0>)
+                ->AddLeaf(&Push<1,0>)
+            ;})
+            ->Decorate(&Push<2,0>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 2,0,1,2,0,1 }));
+    }
+
+    SECTION("Deep decorator leaf unload") {
+        using Static = StaticDecorated<
+            StaticSequence<StaticDecorated<StaticSequence<StaticLeaf<&Push<1,Result::SUCCESS>>>, &Push<0,0>>>,
+            &Push<2,0>,
+            &Push<3,0>
+        >;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->Decorate(&Push<0,0>)
+                ->AddLeaf(&Push<1,Result::SUCCESS>)
+            ;})
+            ->Decorate(&Push<2,0>)
+            ->Decorate(&Push<3,0>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 2,3,0,1,2,3,0,1 }));
+    }
+
+    SECTION("Deep decorator unload") {
+        using Static = StaticDecorated<
+            StaticSequence<
+                StaticDecorated<StaticSequence<StaticLeaf<&Push<1,Result::SUCCESS>>>, &Push<0,0>>,
+                StaticSequence<StaticLeaf<&Push<2,0>>>
+            >,
+            &Push<3,0>
+        >;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->Decorate(&Push<0,0>)
+                ->AddLeaf(&Push<1,Result::SUCCESS>)
+            ;})
+            ->AddSequence([](Branch<TP>* builder) { builder
+                ->AddLeaf(&Push<2,0>)
+            ;})
+            ->Decorate(&Push<3,0>)
+        ;
+        REQUIRE(RequireSameAs<Static>(ctx, root, { 0,0 }) == TP({ 3,0,1,2,3,2 }));
+        RequireSameAs<Static>(ctx, root, Times(20));
+    }
+
+    SECTION("Delayed decorators failing later") {
+        using Static = StaticSelector<
+            StaticDecorated<StaticLeaf<&Push<0,5>>, &PushPeriodic<1,4,1>, &Push<4,Result::SUCCESS>>,
+            StaticDecorated<StaticLeaf<&PushPeriodic<2,3,2>>, &Push<5,2>>
+        >;
+        Branch<TP>* root = ctx.CreateSelector()
+            ->AddLeaf(&Push<0,5>, [](Leaf<TP>* leaf) { leaf
+                ->Decorate(&PushPeriodic<1,4,1>)
+                ->Decorate(&Push<4,Result::SUCCESS>)
+            ;})
+            ->AddLeaf(&PushPeriodic<2,3,2>, [](Leaf<TP>* leaf) { leaf
+                ->Decorate(&Push<5,2>)
+            ;})
+        ;
+        RequireSameAs<Static>(ctx, root, Times(200));
+    }
+
+    SECTION("Interrupted root restarts") {
+        using Static = StaticDecorated<StaticLeaf<&Push<0,100>>, &PushPeriodic<1,5,1>>;
+        Leaf<TP>* root = ctx.CreateLeaf(&Push<0,100>)
+            ->Decorate(&PushPeriodic<1,5,1>)
+        ;
+        RequireSameAs<Static>(ctx, root, Times(60));
+    }
+}
+
+TEST_CASE("Static multiplexers") {
+    BehaviorTreeContext<TP> ctx;
+
+    SECTION("With callback") {
+        using Static = StaticSequence<
+            StaticMultiplexer<&Until<40>,
+                StaticSequence<StaticLeaf<&Push<0,2>>, StaticLeaf<&PushPeriodic<1,3,Result::SUCCESS>>>,
+                StaticDecorated<StaticLeaf<&Push<2,0>>, &PushPeriodic<3,7,1>>
+            >,
+            StaticLeaf<&Push<4,Result::SUCCESS>>
+        >;
+        Branch<TP>* root = ctx.CreateSequence()
+            ->AddMultiplexer(&Until<40>, [](Multiplexer<TP>* builder) { builder
+                ->AddSequence([](Branch<TP>* builder) { builder
+                    ->AddLeaf(&Push<0,2>)
+                    ->AddLeaf(&PushPeriodic<1,3,Result::SUCCESS>)
+                ;})
+                ->AddLeaf(&Push<2,0>, [](Leaf<TP>* leaf) { leaf
+                    ->Decorate(&PushPeriodic<3,7,1>)
+                ;})
+            ;})
+            ->AddLeaf(&Push<4,Result::SUCCESS>)
+        ;
+        RequireSameAs<Static>(ctx, root, Times(200));
+    }
+
+    SECTION("Without callback") {
+        using Static = StaticMultiplexer<nullptr, StaticLeaf<&Push<0,0>>, StaticLeaf<&Push<1,Result::SUCCESS>>>;
+        Multiplexer<TP>* root = ctx.CreateMultiplexer()
+            ->AddLeaf(&Push<0,0>)
+            ->AddLeaf(&Push<1,Result::SUCCESS>)
+        ;
+        RequireSameAs<Static>(ctx, root, Times(20));
+    }
+}
+
+struct Counter
+{
+    int m_value = 0;
+};
+
+static int Count(TP& v, Counter& counter)
+{
+    v.push_back(uint32_t(counter.m_value++));
+    return counter.m_value % 3 == 0 ? Result::SUCCESS : 0;
+}
+
+TEST_CASE("Static node memory") {
+    BehaviorTreeContext<TP,Counter> ctx;
+    using Static = StaticSequence<StaticLeaf<&Count>, StaticDecorated<StaticLeaf<&Count>, &Count>>;
+    Branch<TP,Counter>* root = ctx.CreateSequence()
+        ->AddLeaf(&Count)
+        ->AddLeaf(&Count, [](Leaf<TP,Counter>* leaf) { leaf
+            ->Decorate(&Count)
+        ;})
+    ;
+    RequireSameAs<Static,Counter>(ctx, root, Times(50));
+}
+
+TEST_CASE("Static executors own no memory") {
+    using Static = StaticSelector<
+        StaticDecorated<StaticLeaf<&Push<0,5>>, &Push<1,2>>,
+        StaticMultiplexer<nullptr, StaticLeaf<&Push<2,0>>>
+    >;
+    STATIC_REQUIRE(std::is_trivially_destructible_v<StaticTreeExecutor<Static,TP>>);
+    STATIC_REQUIRE(sizeof(StaticTreeExecutor<Static,TP>) < 256);
+}
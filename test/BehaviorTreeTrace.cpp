@@ -0,0 +1,152 @@
+#include "BehaviorTreeTrace.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using TP = std::vector<uint32_t>;
+using MS = std::monostate;
+
+TEST_CASE("Trace buffers") {
+    TraceBuffer buffer(5);
+    REQUIRE(buffer.Capacity() == 8);
+    for (uint32_t i = 0; i < 20; ++i)
+    {
+        buffer.Record(i, TraceEventType::CALL, i, 0);
+    }
+    REQUIRE(buffer.Recorded() == 20);
+    std::vector<TraceEvent> events = buffer.Events();
+    REQUIRE(events.size() > 0);
+    REQUIRE(events.size() <= 8);
+    REQUIRE(events.back().m_index == 19);
+    for (size_t i = 1; i < events.size(); ++i)
+    {
+        REQUIRE(events[i].m_index == events[i - 1].m_index + 1);
+    }
+}
+
+TEST_CASE("Trace buffers are read while recording") {
+    TraceBuffer buffer(64);
+    std::atomic<bool> done = false;
+    std::thread recorder([&] {
+        for (uint32_t i = 0; i < 200000; ++i)
+        {
+            buffer.Record(i, TraceEventType::CALL, i, int32_t(i));
+        }
+        done = true;
+    });
+    bool consistent = true;
+    while (!done)
+    {
+        std::vector<TraceEvent> events = buffer.Events();
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            // torn or overwritten events would break the sequence
+            consistent = consistent && events[i].m_time == events[i].m_index && events[i].m_result == int32_t(events[i].m_index)
+                && (i == 0 || events[i].m_index == events[i - 1].m_index + 1);
+        }
+    }
+    recorder.join();
+    REQUIRE(consistent);
+}
+
+TEST_CASE("Trace replay") {
+    BehaviorTreeContext<TP> ctx;
+    Multiplexer<TP>* root = ctx.CreateMultiplexer([](TP& v, MS&) { v.push_back(9); return v.size() > 30 ? Result::SUCCESS : 1; })
+        ->AddSequence([](Branch<TP>* builder) { builder
+            ->Decorate([](TP& v, MS&) { return v.size() % 7 == 0 ? Result::FAILURE : 2; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(1); return v.size() % 2 == 0 ? Result::SUCCESS : 1; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(2); return v.size() % 3 == 0 ? Result::FAILURE : Result::SUCCESS; })
+        ;})
+        ->AddSelector([](Branch<TP>* builder) { builder
+            ->DecorateOn("poke", [](TP& v, MS&) { return v.size() % 5 == 0 ? Result::FAILURE : Result::SUCCESS; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(3); return Result::FAILURE; })
+            ->AddLeaf([](TP& v, MS&) { v.push_back(4); return 3; })
+        ;})
+    ;
+
+    TreeExecutor<TP> exec(&ctx, root);
+    TraceBuffer trace(4096);
+    exec.SetTrace(&trace);
+    TP v;
+    for (uint64_t i = 0; i < 40; ++i)
+    {
+        exec.Update(v, i);
+    }
+    std::vector<TraceEvent> events = trace.Events();
+    REQUIRE(events.size() == trace.Recorded());
+    REQUIRE(events[0].m_type == TraceEventType::UPDATE);
+
+    auto tree = ctx.Compile(root);
+
+    SECTION("Reproduces the recorded transitions") {
+        TraceReplayResult result = TraceReplay<TP>::Replay(*tree, events.data(), events.size());
+        REQUIRE(result.m_start == 0);
+        REQUIRE(result.Matches());
+    }
+
+    SECTION("Reports where a trace diverges") {
+        size_t call = 0;
+        while (events[call].m_type != TraceEventType::CALL || events[call].m_index == 0)
+        {
+            call++;
+        }
+        // structure transitions after this call depend on its result
+        events[call + 1].m_index += 1;
+        TraceReplayResult result = TraceReplay<TP>::Replay(*tree, events.data(), events.size());
+        REQUIRE(!result.Matches());
+        REQUIRE(result.m_matched == call + 1);
+    }
+
+    SECTION("Budgeted updates") {
+        TraceBuffer budgetedTrace(4096);
+        TreeExecutor<TP> traced(&ctx, root);
+        traced.SetTrace(&budgetedTrace);
+        TP w;
+        for (uint64_t i = 0; i < 40; ++i)
+        {
+            UpdateBudget budget;
+            budget.m_transitions = 2;
+            traced.Update(w, i, budget);
+        }
+        std::vector<TraceEvent> budgetedEvents = budgetedTrace.Events();
+        REQUIRE(std::any_of(budgetedEvents.begin(), budgetedEvents.end(), [](TraceEvent const& e) { return e.m_type == TraceEventType::SUSPEND; }));
+        REQUIRE(TraceReplay<TP>::Replay(*tree, budgetedEvents.data(), budgetedEvents.size()).Matches());
+    }
+
+    SECTION("Notified decorators") {
+        TraceBuffer notifiedTrace(4096);
+        TreeExecutor<TP> traced(&ctx, root);
+        traced.SetTrace(&notifiedTrace);
+        TP w;
+        for (uint64_t i = 0; i < 40; ++i)
+        {
+            if (i % 3 == 0)
+            {
+                traced.Notify(ctx.Callbacks().GetEvent("poke"));
+            }
+            traced.Update(w, i);
+        }
+        std::vector<TraceEvent> notifiedEvents = notifiedTrace.Events();
+        REQUIRE(std::any_of(notifiedEvents.begin(), notifiedEvents.end(), [](TraceEvent const& e) { return e.m_type == TraceEventType::NOTIFY; }));
+        REQUIRE(TraceReplay<TP>::Replay(*tree, notifiedEvents.data(), notifiedEvents.size()).Matches());
+    }
+
+    SECTION("Starts after wrapping") {
+        TraceBuffer small(64);
+        TreeExecutor<TP> traced(&ctx, root);
+        traced.SetTrace(&small);
+        TP w;
+        for (uint64_t i = 0; i < 200; ++i)
+        {
+            traced.Update(w, i);
+        }
+        std::vector<TraceEvent> tail = small.Events();
+        REQUIRE(tail.size() < small.Recorded());
+        TraceReplayResult result = TraceReplay<TP>::Replay(*tree, tail.data(), tail.size());
+        REQUIRE(result.m_start > 0);
+        REQUIRE(result.Matches());
+    }
+}